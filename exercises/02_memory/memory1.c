@@ -93,6 +93,7 @@ TEST(test_add_and_grow) {
     ASSERT_STR_EQ(list->items[2], "gamma");
 
     stringlist_free(list);
+    ASSERT_NO_LEAKS();
 }
 
 int main(void) {
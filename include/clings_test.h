@@ -13,44 +13,305 @@
  *       RUN_TEST(test_addition);
  *       TEST_REPORT();
  *   }
+ *
+ * Benchmarks time one iteration of their body:
+ *
+ *   BENCH(bench_sum) {
+ *       DO_NOT_OPTIMIZE(sum(data, 1000));
+ *   }
+ *
+ *   RUN_BENCH(bench_sum, 50);   -- 50 timed samples, then min/median/p99
+ *
+ * After RUN_BENCH, clings_bench_last holds the per-iteration times, so a
+ * test can compare two implementations.
+ *
+ * With CLINGS_REPORT=FD in the environment, the harness also writes
+ * results for the clings runner to that descriptor, a pipe apart from the
+ * program's output, as JSON lines: one per test (name, status, duration,
+ * file:line of the failed assertion) as it finishes, and one per benchmark
+ * after the summary, which the runner checks against the exercise's
+ * budgets in info.toml.
+ *
+ * When clings builds the tests it links malloc, calloc, realloc and free
+ * through the allocation tracker below (-DCLINGS_TRACK_ALLOCS with
+ * -Wl,--wrap). Each RUN_TEST starts counting afresh:
+ *
+ *   TEST(test_no_leaks) {
+ *       List *l = list_create();
+ *       list_push(l, 1);
+ *       list_free(l);
+ *       ASSERT_NO_LEAKS();
+ *       ASSERT_ALLOCS_LE(2);
+ *   }
+ *
+ * clings_allocs holds the counts, e.g. realloc growth events for checks
+ * on a growth policy. Builds without the tracker skip these assertions,
+ * and so does ASSERT_NO_LEAKS once more blocks are live than the tracker
+ * can hold; the test's result then says so.
+ *
+ * With CLINGS_TEST_JOBS=N in the environment (0 = one per core), each
+ * RUN_TEST runs in a forked child, N at a time, so a crash fails only its
+ * own test, and so does an exit() before the test body returns.
+ * CLINGS_TEST_TIMEOUT=S (default 10, 0 = none, fractions allowed)
+ * limits each test.
+ * Output still appears in RUN_TEST order.
  */
 #ifndef CLINGS_TEST_H
 #define CLINGS_TEST_H
 
+/* POSIX.1b, for clock_gettime(CLOCK_MONOTONIC). Only takes effect when the
+ * harness is included before any system header. */
+#if !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) && \
+    !defined(_GNU_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLINGS_CAN_FORK
+#include <poll.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 static int clings_tests_run    = 0;
 static int clings_tests_passed = 0;
 static int clings_tests_failed = 0;
 
+/* Where the current test failed, for the report; NULL while it passes */
+static const char *clings_fail_file = NULL;
+static int clings_fail_line = 0;
+
+/* Why the current test skipped a check; printed with its result */
+static const char *clings_skip_note = NULL;
+
+/* Print where an assertion failed and count the failure */
+static inline void clings_fail_at(const char *file, int line) {
+    printf("    at %s:%d\n", file, line);
+    clings_fail_file = file;
+    clings_fail_line = line;
+    clings_tests_failed++;
+}
+
 /* Undefine TEST if it was set by -DTEST on the command line */
 #ifdef TEST
 #undef TEST
 #endif
 
+/* ---- Allocation tracking ------------------------------------------- */
+
+/* Allocator activity since the last clings_alloc_reset() */
+struct clings_alloc_stats {
+    long   allocs;      /* blocks from malloc, calloc and realloc(NULL) */
+    long   frees;       /* counted blocks freed */
+    long   reallocs;    /* realloc calls that moved or resized a block */
+    long   growths;     /* reallocs to a larger size */
+    long   live_blocks;
+    size_t bytes;       /* bytes requested in total */
+    size_t live_bytes;
+    size_t peak_bytes;
+    int    overflowed;  /* blocks the table had no room for are left out
+                           of live_blocks, live_bytes and peak_bytes */
+};
+
+static struct clings_alloc_stats clings_allocs;
+
+#ifdef CLINGS_TRACK_ALLOCS
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void  __real_free(void *ptr);
+
+/* Live blocks and their sizes, in an open-addressing table in static
+ * memory. Blocks from elsewhere (strdup inside libc) are not in it, and
+ * blocks from before the last reset are not counted when freed. A block
+ * sits at most CLINGS_ALLOC_MAX_PROBE slots past its hash, which bounds
+ * every lookup; one that finds no room there marks the stats overflowed. */
+#define CLINGS_ALLOC_SLOTS  (1 << 16)
+#define CLINGS_ALLOC_MAX_PROBE 64
+static struct clings_alloc_slot {
+    void    *ptr;
+    size_t   size;
+    unsigned gen;
+} clings_alloc_table[CLINGS_ALLOC_SLOTS];
+static unsigned clings_alloc_gen = 1;
+#define CLINGS_ALLOC_MASK   (CLINGS_ALLOC_SLOTS - 1)
+
+static inline size_t clings_alloc_hash(const void *ptr) {
+    return (size_t)(((uintptr_t)ptr >> 4) * 2654435761u) & CLINGS_ALLOC_MASK;
+}
+
+static inline void clings_alloc_add(void *ptr, size_t size) {
+    size_t i = clings_alloc_hash(ptr);
+    for (int n = 0; n < CLINGS_ALLOC_MAX_PROBE; n++, i = (i + 1) & CLINGS_ALLOC_MASK) {
+        if (clings_alloc_table[i].ptr == NULL) {
+            clings_alloc_table[i].ptr  = ptr;
+            clings_alloc_table[i].size = size;
+            clings_alloc_table[i].gen  = clings_alloc_gen;
+            clings_allocs.live_blocks++;
+            clings_allocs.live_bytes += size;
+            if (clings_allocs.live_bytes > clings_allocs.peak_bytes) {
+                clings_allocs.peak_bytes = clings_allocs.live_bytes;
+            }
+            return;
+        }
+    }
+    clings_allocs.overflowed = 1;
+}
+
+/* Forget a block; returns its size if it was counted, else 0. Entries
+ * after it move back into the gap, so lookups can stop at an empty slot;
+ * none further than CLINGS_ALLOC_MAX_PROBE from the gap may move. */
+static inline size_t clings_alloc_remove(const void *ptr, int *counted) {
+    size_t i = clings_alloc_hash(ptr);
+    *counted = 0;
+    if (ptr == NULL) return 0;
+    for (int n = 0; clings_alloc_table[i].ptr != ptr; n++) {
+        if (clings_alloc_table[i].ptr == NULL || n == CLINGS_ALLOC_MAX_PROBE) return 0;
+        i = (i + 1) & CLINGS_ALLOC_MASK;
+    }
+    size_t size = clings_alloc_table[i].size;
+    *counted = clings_alloc_table[i].gen == clings_alloc_gen;
+    for (size_t j = i;;) {
+        j = (j + 1) & CLINGS_ALLOC_MASK;
+        if (clings_alloc_table[j].ptr == NULL) break;
+        if (((j - i) & CLINGS_ALLOC_MASK) >= CLINGS_ALLOC_MAX_PROBE) break;
+        size_t home = clings_alloc_hash(clings_alloc_table[j].ptr);
+        int stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            clings_alloc_table[i] = clings_alloc_table[j];
+            i = j;
+        }
+    }
+    clings_alloc_table[i].ptr = NULL;
+    if (!*counted) return 0;
+    clings_allocs.live_blocks--;
+    clings_allocs.live_bytes -= size;
+    return size;
+}
+
+void *__wrap_malloc(size_t size);
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    if (ptr) {
+        clings_allocs.allocs++;
+        clings_allocs.bytes += size;
+        clings_alloc_add(ptr, size);
+    }
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_calloc(size_t count, size_t size) {
+    void *ptr = __real_calloc(count, size);
+    if (ptr) {
+        clings_allocs.allocs++;
+        clings_allocs.bytes += count * size;
+        clings_alloc_add(ptr, count * size);
+    }
+    return ptr;
+}
+
+void *__wrap_realloc(void *old, size_t size);
+void *__wrap_realloc(void *old, size_t size) {
+    if (old == NULL) return __wrap_malloc(size);
+    void *ptr = __real_realloc(old, size);
+    if (ptr == NULL && size != 0) return NULL;  /* old is still live */
+    int counted;
+    size_t old_size = clings_alloc_remove(old, &counted);
+    if (counted) clings_allocs.frees++;
+    if (ptr) {
+        clings_allocs.reallocs++;
+        if (size > old_size) {
+            clings_allocs.growths++;
+            clings_allocs.bytes += size - old_size;
+        }
+        if (counted) clings_allocs.frees--;
+        else clings_allocs.allocs++;
+        clings_alloc_add(ptr, size);
+    }
+    return ptr;
+}
+
+void __wrap_free(void *ptr);
+void __wrap_free(void *ptr) {
+    int counted;
+    clings_alloc_remove(ptr, &counted);
+    if (counted) clings_allocs.frees++;
+    __real_free(ptr);
+}
+
+
+/* Assert at most n blocks were allocated */
+#define ASSERT_ALLOCS_LE(n) do {                                    \
+    if (clings_allocs.allocs > (long)(n)) {                         \
+        printf("FAILED\n");                                         \
+        printf("    expected at most %ld allocations, got %ld\n",   \
+            (long)(n), clings_allocs.allocs);                       \
+        clings_fail_at(__FILE__, __LINE__);                         \
+        return;                                                     \
+    }                                                               \
+} while(0)
+
+/* Assert every block allocated since the test started was freed; skipped
+ * once the tracker lost count of some */
+#define ASSERT_NO_LEAKS() do {                                      \
+    if (clings_allocs.overflowed) {                                 \
+        clings_skip_note = "leak check skipped: too many live "     \
+            "blocks to track";                                      \
+    } else if (clings_allocs.live_blocks != 0) {                    \
+        printf("FAILED\n");                                         \
+        printf("    leaked %ld block(s), %zu bytes\n",              \
+            clings_allocs.live_blocks, clings_allocs.live_bytes);   \
+        clings_fail_at(__FILE__, __LINE__);                         \
+        return;                                                     \
+    }                                                               \
+} while(0)
+
+#else
+
+#define CLINGS_NO_TRACKER \
+    "allocation checks skipped: built without the allocation tracker"
+#define ASSERT_ALLOCS_LE(n) ((void)(n), (void)(clings_skip_note = CLINGS_NO_TRACKER))
+#define ASSERT_NO_LEAKS()   ((void)(clings_skip_note = CLINGS_NO_TRACKER))
+
+#endif /* CLINGS_TRACK_ALLOCS */
+
+/* Start counting afresh; blocks live now are no longer counted */
+static inline void clings_alloc_reset(void) {
+    memset(&clings_allocs, 0, sizeof clings_allocs);
+#ifdef CLINGS_TRACK_ALLOCS
+    clings_alloc_gen++;
+#endif
+}
+
+/* ---- Tests ---------------------------------------------------------- */
+
 /* Define a test function */
 #define TEST(name) static void name(void)
 
 /* Run a test and track results */
-#define RUN_TEST(name) do {                                         \
-    clings_tests_run++;                                             \
-    int _prev_failed = clings_tests_failed;                         \
-    printf("  test %-40s ", #name);                                 \
-    name();                                                         \
-    if (clings_tests_failed == _prev_failed) {                      \
-        clings_tests_passed++;                                      \
-        printf("ok\n");                                             \
-    }                                                               \
-} while(0)
+#define RUN_TEST(name) clings_run_test(#name, name)
 
 /* Basic assertion */
 #define ASSERT(expr) do {                                           \
     if (!(expr)) {                                                  \
         printf("FAILED\n");                                         \
         printf("    assertion failed: %s\n", #expr);                \
-        printf("    at %s:%d\n", __FILE__, __LINE__);               \
-        clings_tests_failed++;                                      \
+        clings_fail_at(__FILE__, __LINE__);                         \
         return;                                                     \
     }                                                               \
 } while(0)
@@ -60,8 +321,7 @@ static int clings_tests_failed = 0;
     if ((a) != (b)) {                                               \
         printf("FAILED\n");                                         \
         printf("    expected: %s == %s\n", #a, #b);                 \
-        printf("    at %s:%d\n", __FILE__, __LINE__);               \
-        clings_tests_failed++;                                      \
+        clings_fail_at(__FILE__, __LINE__);                         \
         return;                                                     \
     }                                                               \
 } while(0)
@@ -71,8 +331,7 @@ static int clings_tests_failed = 0;
     if (strcmp((a), (b)) != 0) {                                    \
         printf("FAILED\n");                                         \
         printf("    expected: \"%s\" == \"%s\"\n", (a), (b));       \
-        printf("    at %s:%d\n", __FILE__, __LINE__);               \
-        clings_tests_failed++;                                      \
+        clings_fail_at(__FILE__, __LINE__);                         \
         return;                                                     \
     }                                                               \
 } while(0)
@@ -82,16 +341,606 @@ static int clings_tests_failed = 0;
     if ((a) == (b)) {                                               \
         printf("FAILED\n");                                         \
         printf("    expected: %s != %s\n", #a, #b);                 \
-        printf("    at %s:%d\n", __FILE__, __LINE__);               \
-        clings_tests_failed++;                                      \
+        clings_fail_at(__FILE__, __LINE__);                         \
         return;                                                     \
     }                                                               \
 } while(0)
 
+/* ---- Benchmarks ---------------------------------------------------- */
+
+/* Define a benchmark; the body is one iteration */
+#define BENCH(name) static void name(void)
+
+/* Keep the compiler from optimizing away the computation of x */
+#if defined(__GNUC__)
+#define DO_NOT_OPTIMIZE(x) do {                                     \
+    __typeof__(x) _clings_value = (x);                              \
+    __asm__ volatile("" : : "r"(&_clings_value) : "memory");        \
+} while(0)
+#else
+static volatile int clings_bench_sink;
+#define DO_NOT_OPTIMIZE(x) (clings_bench_sink = (int)(x))
+#endif
+
+/* Per-iteration times of the last RUN_BENCH, in nanoseconds */
+struct clings_bench_stats {
+    double min_ns;
+    double median_ns;
+    double p99_ns;
+    long   iters;       /* iterations per sample */
+    int    samples;
+    long   allocs;      /* allocations per iteration; -1 if not tracked */
+};
+
+static struct clings_bench_stats clings_bench_last;
+
+/* Last results of every benchmark run, for the report */
+#define CLINGS_BENCH_MAX_RECORDS  64
+static struct clings_bench_record {
+    const char *name;
+    struct clings_bench_stats stats;
+} clings_bench_records[CLINGS_BENCH_MAX_RECORDS];
+static int clings_bench_count = 0;
+
+/* A sample runs the body until it takes at least this long, so the
+ * clock's resolution and overhead do not show in the result. */
+#ifndef CLINGS_BENCH_MIN_SAMPLE_NS
+#define CLINGS_BENCH_MIN_SAMPLE_NS 200000.0
+#endif
+#define CLINGS_BENCH_WARMUP       3
+#define CLINGS_BENCH_MAX_SAMPLES  1000
+
+/* The POSIX monotonic clock. An exercise that includes a system header
+ * first keeps POSIX.1b hidden under -std=c11; Linux has the call all the
+ * same, so declare it there. Elsewhere the C11 wall clock is the fallback,
+ * and the median absorbs its rare steps. */
+#if defined(CLOCK_MONOTONIC)
+#define CLINGS_CLOCK_MONOTONIC CLOCK_MONOTONIC
+#elif defined(__linux__)
+extern int clock_gettime(int clock_id, struct timespec *ts);
+#define CLINGS_CLOCK_MONOTONIC 1    /* CLOCK_MONOTONIC in <linux/time.h> */
+#endif
+
+static inline double clings_now_ns(void) {
+    static time_t epoch = 0;    /* keeps the result exact in a double */
+    struct timespec ts;
+#if defined(CLINGS_CLOCK_MONOTONIC)
+    clock_gettime(CLINGS_CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    if (epoch == 0) epoch = ts.tv_sec;
+    return (double)(ts.tv_sec - epoch) * 1e9 + (double)ts.tv_nsec;
+}
+
+static inline double clings_time_batch(void (*body)(void), long iters) {
+    double start = clings_now_ns();
+    for (long i = 0; i < iters; i++) {
+        body();
+    }
+    return clings_now_ns() - start;
+}
+
+static inline int clings_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void clings_print_ns(const char *label, double ns) {
+    if (ns < 1e3)      printf("%s %7.1fns", label, ns);
+    else if (ns < 1e6) printf("%s %7.2fus", label, ns / 1e3);
+    else               printf("%s %7.2fms", label, ns / 1e6);
+}
+
+static inline struct clings_bench_stats clings_measure(void (*body)(void), int samples) {
+    static double times[CLINGS_BENCH_MAX_SAMPLES];
+    struct clings_bench_stats stats;
+    long iters = 1;
+
+    if (samples < 1) samples = 1;
+    if (samples > CLINGS_BENCH_MAX_SAMPLES) samples = CLINGS_BENCH_MAX_SAMPLES;
+
+    /* Calibrate: double the batch until one takes long enough */
+    while (clings_time_batch(body, iters) < CLINGS_BENCH_MIN_SAMPLE_NS
+           && iters < (1L << 30)) {
+        iters *= 2;
+    }
+    for (int i = 0; i < CLINGS_BENCH_WARMUP; i++) {
+        clings_time_batch(body, iters);
+    }
+    for (int i = 0; i < samples; i++) {
+        times[i] = clings_time_batch(body, iters) / (double)iters;
+    }
+    qsort(times, (size_t)samples, sizeof times[0], clings_cmp_double);
+
+    stats.min_ns    = times[0];
+    stats.median_ns = samples % 2
+        ? times[samples / 2]
+        : (times[samples / 2 - 1] + times[samples / 2]) / 2;
+    stats.p99_ns    = times[(samples * 99 + 99) / 100 - 1];
+    stats.iters     = iters;
+    stats.samples   = samples;
+    stats.allocs    = -1;
+    return stats;
+}
+
+static inline void clings_record_bench(const char *name, struct clings_bench_stats stats) {
+    int i = 0;
+    while (i < clings_bench_count && strcmp(clings_bench_records[i].name, name) != 0) {
+        i++;
+    }
+    if (i == CLINGS_BENCH_MAX_RECORDS) return;
+    if (i == clings_bench_count) clings_bench_count++;
+    clings_bench_records[i].name  = name;
+    clings_bench_records[i].stats = stats;
+}
+
+static inline void clings_run_bench(const char *name, void (*body)(void), int samples) {
+    clings_bench_last = clings_measure(body, samples);
+#ifdef CLINGS_TRACK_ALLOCS
+    long before = clings_allocs.allocs;
+    body();
+    clings_bench_last.allocs = clings_allocs.allocs - before;
+#endif
+    clings_record_bench(name, clings_bench_last);
+
+    printf("  bench %-39s", name);
+    clings_print_ns(" min", clings_bench_last.min_ns);
+    clings_print_ns("  median", clings_bench_last.median_ns);
+    clings_print_ns("  p99", clings_bench_last.p99_ns);
+    printf("  (%d x %ld)\n", clings_bench_last.samples, clings_bench_last.iters);
+}
+
+/* Time `samples` calibrated batches of a benchmark and report them */
+#define RUN_BENCH(name, samples) clings_run_bench(#name, name, (samples))
+
+/* A fixed chain of dependent multiply-adds. Its speed relative to the
+ * reference machine scales the budgets, so they hold on other machines. */
+static inline void clings_calibration_body(void) {
+    static volatile unsigned seed = 1;
+    unsigned x = seed;
+    for (int i = 0; i < 100; i++) {
+        x = x * 1664525u + 1013904223u;
+    }
+    seed = x;
+}
+
+/* ---- Report for the clings runner ------------------------------------ */
+
+/* One record, built whole so it goes out in a single write */
+struct clings_report_line {
+    char text[4096];
+    size_t len;     /* past the end of text once it no longer fits */
+};
+
+static inline void clings_report_printf(struct clings_report_line *r, const char *fmt, ...) {
+    va_list args;
+    if (r->len >= sizeof r->text) return;
+    va_start(args, fmt);
+    int n = vsnprintf(r->text + r->len, sizeof r->text - r->len, fmt, args);
+    va_end(args);
+    r->len = n < 0 ? sizeof r->text : r->len + (size_t)n;
+}
+
+static inline void clings_report_string(struct clings_report_line *r, const char *s) {
+    clings_report_printf(r, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') clings_report_printf(r, "\\%c", c);
+        else if (c < 0x20)         clings_report_printf(r, "\\u%04x", c);
+        else                       clings_report_printf(r, "%c", c);
+    }
+    clings_report_printf(r, "\"");
+}
+
+#ifdef CLINGS_CAN_FORK
+
+/* The report pipe from CLINGS_REPORT; -1 without one */
+static inline int clings_report_fd(void) {
+    static int fd = -2;
+    if (fd == -2) {
+        const char *value = getenv("CLINGS_REPORT");
+        char *end = NULL;
+        long n = value && *value ? strtol(value, &end, 10) : -1;
+        fd = n >= 0 && n <= INT_MAX && end != NULL && *end == '\0' ? (int)n : -1;
+    }
+    return fd;
+}
+
+/* Send a record with its newline; one that did not fit is dropped */
+static inline void clings_report_send(struct clings_report_line *r) {
+    size_t sent = 0;
+    clings_report_printf(r, "\n");
+    if (r->len >= sizeof r->text) return;
+    fflush(stdout);
+    while (sent < r->len) {
+        ssize_t n = write(clings_report_fd(), r->text + sent, r->len - sent);
+        if (n > 0)                 sent += (size_t)n;
+        else if (n == 0 || errno != EINTR) return;
+    }
+}
+
+#else
+
+static inline int clings_report_fd(void) { return -1; }
+static inline void clings_report_send(struct clings_report_line *r) { (void)r; }
+
+#endif /* CLINGS_CAN_FORK */
+
+/* Benchmark results for the clings runner, sent after the summary */
+static inline void clings_emit_report(void) {
+    struct clings_report_line r;
+    if (clings_report_fd() < 0) return;
+    if (clings_bench_count > 0) {
+        struct clings_bench_stats cal = clings_measure(clings_calibration_body, 21);
+        r.len = 0;
+        clings_report_printf(&r, "{\"calibration_ns\":%.3f}", cal.median_ns);
+        clings_report_send(&r);
+    }
+    for (int i = 0; i < clings_bench_count; i++) {
+        const struct clings_bench_record *b = &clings_bench_records[i];
+        r.len = 0;
+        clings_report_printf(&r, "{\"bench\":");
+        clings_report_string(&r, b->name);
+        clings_report_printf(&r, ",\"min_ns\":%.3f,\"median_ns\":%.3f,"
+            "\"p99_ns\":%.3f,\"iters\":%ld,\"samples\":%d",
+            b->stats.min_ns, b->stats.median_ns, b->stats.p99_ns,
+            b->stats.iters, b->stats.samples);
+        if (b->stats.allocs >= 0) clings_report_printf(&r, ",\"allocs\":%ld", b->stats.allocs);
+        clings_report_printf(&r, "}");
+        clings_report_send(&r);
+    }
+}
+
+/* ---- Test runners --------------------------------------------------- */
+
+/* One test's result for the clings runner; a negative duration is left
+ * out. Sent as soon as the test is done. */
+static inline void clings_emit_test(const char *name, const char *status, double duration_ns) {
+    struct clings_report_line r;
+    if (clings_report_fd() < 0) return;
+    r.len = 0;
+    clings_report_printf(&r, "{\"test\":");
+    clings_report_string(&r, name);
+    clings_report_printf(&r, ",\"status\":\"%s\"", status);
+    if (duration_ns >= 0) clings_report_printf(&r, ",\"duration_ns\":%.0f", duration_ns);
+    if (clings_fail_file != NULL) {
+        clings_report_printf(&r, ",\"file\":");
+        clings_report_string(&r, clings_fail_file);
+        clings_report_printf(&r, ",\"line\":%d", clings_fail_line);
+    }
+    clings_report_printf(&r, "}");
+    clings_report_send(&r);
+}
+
+/* How a test body ended */
+struct clings_result {
+    int passed;
+    double duration_ns;
+    const char *file;   /* of the failed assertion, or NULL */
+    int line;
+};
+
+/* Run a test body in this process and print its verdict */
+static inline struct clings_result clings_run_body(void (*test)(void)) {
+    struct clings_result r;
+    int prev_failed = clings_tests_failed;
+    clings_fail_file = NULL;
+    clings_skip_note = NULL;
+    clings_alloc_reset();
+    double start = clings_now_ns();
+    test();
+    r.duration_ns = clings_now_ns() - start;
+    r.passed = clings_tests_failed == prev_failed;
+    r.file = clings_fail_file;
+    r.line = clings_fail_line;
+    if (r.passed) printf("ok\n");
+    if (clings_skip_note != NULL) printf("    %s\n", clings_skip_note);
+    return r;
+}
+
+/* Run a test in this process; returns whether it passed */
+static inline int clings_run_in_process(const char *name, void (*test)(void)) {
+    struct clings_result r = clings_run_body(test);
+    clings_emit_test(name, r.passed ? "passed" : "failed", r.duration_ns);
+    return r.passed;
+}
+
+#ifdef CLINGS_CAN_FORK
+
+#define CLINGS_MAX_JOBS 64
+
+/* Output a child may write before its turn to be shown; more is dropped */
+#define CLINGS_JOB_OUTPUT_MAX  (1 << 20)
+
+/* Buffers for children's output, kept out of the allocation counts */
+#ifdef CLINGS_TRACK_ALLOCS
+#define CLINGS_RAW_REALLOC __real_realloc
+#define CLINGS_RAW_FREE    __real_free
+#else
+#define CLINGS_RAW_REALLOC realloc
+#define CLINGS_RAW_FREE    free
+#endif
+
+/* Tests in flight, oldest first, in a ring. The oldest child's output is
+ * passed through as it comes; the others' is read ahead into buf, so no
+ * child blocks on a full pipe and runs into its timeout waiting for us. */
+static struct clings_job {
+    const char *name;
+    pid_t pid;
+    int fd;         /* read end of the child's stdout and stderr; -1 at EOF */
+    int result_fd;  /* read end of the pipe for its clings_child_result */
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t dropped; /* bytes beyond CLINGS_JOB_OUTPUT_MAX */
+} clings_jobs[CLINGS_MAX_JOBS];
+static int clings_jobs_head  = 0;
+static int clings_jobs_count = 0;
+
+static inline long clings_env_long(const char *name, long fallback) {
+    const char *value = getenv(name);
+    return value && *value ? strtol(value, NULL, 10) : fallback;
+}
+
+/* Seconds each child may take; 0 or less means no limit */
+static inline double clings_test_timeout(void) {
+    const char *value = getenv("CLINGS_TEST_TIMEOUT");
+    return value && *value ? strtod(value, NULL) : 10;
+}
+
+/* Children in flight at once; 0 runs tests in this process */
+static inline int clings_test_jobs(void) {
+    static long jobs = -1;
+    if (jobs < 0) {
+        jobs = clings_env_long("CLINGS_TEST_JOBS", -1);
+        if (jobs == 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (jobs < 0) jobs = 0;
+        if (jobs > CLINGS_MAX_JOBS) jobs = CLINGS_MAX_JOBS;
+    }
+    return (int)jobs;
+}
+
+static inline const char *clings_signal_name(int sig) {
+    switch (sig) {
+    case SIGSEGV: return "SIGSEGV";
+    case SIGBUS:  return "SIGBUS";
+    case SIGABRT: return "SIGABRT";
+    case SIGFPE:  return "SIGFPE";
+    case SIGILL:  return "SIGILL";
+    case SIGKILL: return "SIGKILL";
+    case SIGXCPU: return "SIGXCPU";
+    case SIGPIPE: return "SIGPIPE";
+    default:      return "signal";
+    }
+}
+
+/* Keep a younger child's output until its turn */
+static inline void clings_job_keep(struct clings_job *job, const char *data, size_t n) {
+    if (job->len + n > job->cap && job->cap < CLINGS_JOB_OUTPUT_MAX) {
+        size_t cap = job->cap ? job->cap * 2 : 4096;
+        if (cap > CLINGS_JOB_OUTPUT_MAX) cap = CLINGS_JOB_OUTPUT_MAX;
+        char *buf = CLINGS_RAW_REALLOC(job->buf, cap);
+        if (buf != NULL) {
+            job->buf = buf;
+            job->cap = cap;
+        }
+    }
+    size_t kept = job->cap - job->len < n ? job->cap - job->len : n;
+    if (kept > 0) memcpy(job->buf + job->len, data, kept);
+    job->len += kept;
+    job->dropped += n - kept;
+}
+
+/* Wait for output from any child and read what is there: the oldest's
+ * goes to stdout, the rest is kept */
+static inline void clings_pump_jobs(void) {
+    struct pollfd fds[CLINGS_MAX_JOBS];
+    int slots[CLINGS_MAX_JOBS];
+    nfds_t count = 0;
+    for (int k = 0; k < clings_jobs_count; k++) {
+        int slot = (clings_jobs_head + k) % CLINGS_MAX_JOBS;
+        if (clings_jobs[slot].fd < 0) continue;
+        fds[count].fd = clings_jobs[slot].fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        slots[count++] = slot;
+    }
+    if (poll(fds, count, -1) < 0) return;   /* EINTR: the caller retries */
+    for (nfds_t k = 0; k < count; k++) {
+        if (fds[k].revents == 0) continue;
+        struct clings_job *job = &clings_jobs[slots[k]];
+        char buf[4096];
+        ssize_t n = read(job->fd, buf, sizeof buf);
+        if (n > 0 && slots[k] == clings_jobs_head) {
+            fwrite(buf, 1, (size_t)n, stdout);
+        } else if (n > 0) {
+            clings_job_keep(job, buf, (size_t)n);
+        } else if (n == 0 || errno != EINTR) {
+            close(job->fd);
+            job->fd = -1;
+        }
+    }
+}
+
+/* What a child sends back once its test body has returned. Only the
+ * used benches are sent, well within a pipe's buffer, so the write never
+ * waits for us. */
+struct clings_child_result {
+    struct clings_result result;
+    int bench_count;
+    struct clings_bench_record benches[CLINGS_BENCH_MAX_RECORDS];
+};
+
+/* Read the child's result; false if it never got to send one */
+static inline int clings_read_result(int fd, struct clings_child_result *msg) {
+    char *p = (char *)msg;
+    size_t got = 0;
+    while (got < sizeof *msg) {
+        ssize_t n = read(fd, p + got, sizeof *msg - got);
+        if (n > 0) got += (size_t)n;
+        else if (n == 0 || errno != EINTR) break;
+    }
+    if (got < offsetof(struct clings_child_result, benches)) return 0;
+    if (msg->bench_count < 0 || msg->bench_count > CLINGS_BENCH_MAX_RECORDS) return 0;
+    return got == offsetof(struct clings_child_result, benches)
+                  + (size_t)msg->bench_count * sizeof msg->benches[0];
+}
+
+/* Pass the oldest child's output through, reap it and count its test */
+static inline void clings_finish_oldest(void) {
+    struct clings_job *job = &clings_jobs[clings_jobs_head];
+    struct clings_child_result msg;
+    int status = 0;
+
+    printf("  test %-40s ", job->name);
+    if (job->len > 0) fwrite(job->buf, 1, job->len, stdout);
+    if (job->dropped > 0) {
+        printf("\n    [%zu bytes of output dropped]\n", job->dropped);
+    }
+    CLINGS_RAW_FREE(job->buf);
+    job->buf = NULL;
+    job->len = job->cap = job->dropped = 0;
+    fflush(stdout);
+    while (job->fd >= 0) {
+        clings_pump_jobs();
+        fflush(stdout);
+    }
+    int finished = clings_read_result(job->result_fd, &msg);
+    close(job->result_fd);
+    while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR) {}
+
+    /* The verdict comes from the result the child sent after its test
+     * body returned; without one, from how the child ended */
+    clings_tests_run++;
+    clings_fail_file = NULL;
+    if (finished) {
+        for (int i = 0; i < msg.bench_count; i++) {
+            clings_record_bench(msg.benches[i].name, msg.benches[i].stats);
+        }
+        if (msg.result.passed) clings_tests_passed++;
+        else                   clings_tests_failed++;
+        clings_fail_file = msg.result.file;
+        clings_fail_line = msg.result.line;
+        clings_emit_test(job->name, msg.result.passed ? "passed" : "failed",
+            msg.result.duration_ns);
+        clings_fail_file = NULL;
+    } else {
+        clings_tests_failed++;
+        if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+            double timeout = clings_test_timeout();
+            printf("TIMED OUT\n    after %g s (CLINGS_TEST_TIMEOUT)\n", timeout);
+            clings_emit_test(job->name, "timed_out", timeout * 1e9);
+        } else if (WIFSIGNALED(status)) {
+            printf("CRASHED\n    killed by signal %d (%s)\n",
+                WTERMSIG(status), clings_signal_name(WTERMSIG(status)));
+            clings_emit_test(job->name, "crashed", -1);
+        } else {
+            printf("EXITED (status %d)\n    the process exited before the test finished\n",
+                WEXITSTATUS(status));
+            clings_emit_test(job->name, "exited", -1);
+        }
+    }
+    fflush(stdout);
+    clings_jobs_head = (clings_jobs_head + 1) % CLINGS_MAX_JOBS;
+    clings_jobs_count--;
+}
+
+static inline void clings_finish_all(void) {
+    while (clings_jobs_count > 0) clings_finish_oldest();
+}
+
+/* Start a test in a child; false if no child could be started */
+static inline int clings_fork_test(const char *name, void (*test)(void)) {
+    int fds[2], rfds[2];
+    if (clings_jobs_count == clings_test_jobs()) clings_finish_oldest();
+    fflush(stdout);
+    fflush(stderr);
+    if (pipe(fds) != 0) return 0;
+    if (pipe(rfds) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        close(rfds[0]);
+        close(rfds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        static struct clings_child_result msg;
+        double timeout = clings_test_timeout();
+        /* The test body gets no way to write records; we send them */
+        if (clings_report_fd() >= 0) close(clings_report_fd());
+        close(fds[0]);
+        close(rfds[0]);
+        dup2(fds[1], 1);
+        dup2(fds[1], 2);
+        close(fds[1]);
+        if (timeout > 0) {
+            struct itimerval timer = {{0, 0}, {0, 0}};
+            timer.it_value.tv_sec  = (time_t)timeout;
+            timer.it_value.tv_usec = (long)((timeout - (double)(time_t)timeout) * 1e6);
+            if (timer.it_value.tv_sec == 0 && timer.it_value.tv_usec == 0) {
+                timer.it_value.tv_usec = 1;
+            }
+            setitimer(ITIMER_REAL, &timer, NULL);
+        }
+        /* Report only this test's benchmarks, not the parent's */
+        clings_bench_count = 0;
+        msg.result = clings_run_body(test);
+        fflush(stdout);
+        msg.bench_count = clings_bench_count;
+        memcpy(msg.benches, clings_bench_records,
+            (size_t)clings_bench_count * sizeof msg.benches[0]);
+        if (write(rfds[1], &msg, offsetof(struct clings_child_result, benches)
+                  + (size_t)msg.bench_count * sizeof msg.benches[0]) < 0) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    close(rfds[1]);
+    int slot = (clings_jobs_head + clings_jobs_count) % CLINGS_MAX_JOBS;
+    clings_jobs[slot].name = name;
+    clings_jobs[slot].pid  = pid;
+    clings_jobs[slot].fd   = fds[0];
+    clings_jobs[slot].result_fd = rfds[0];
+    clings_jobs[slot].buf  = NULL;
+    clings_jobs[slot].len  = clings_jobs[slot].cap = clings_jobs[slot].dropped = 0;
+    clings_jobs_count++;
+    return 1;
+}
+
+#endif /* CLINGS_CAN_FORK */
+
+static inline void clings_run_test(const char *name, void (*test)(void)) {
+#ifdef CLINGS_CAN_FORK
+    if (clings_test_jobs() > 0) {
+        if (clings_fork_test(name, test)) return;
+        clings_finish_all();    /* keep the output in order */
+    }
+#endif
+    printf("  test %-40s ", name);
+    clings_tests_run++;
+    if (clings_run_in_process(name, test)) clings_tests_passed++;
+}
+
+#ifdef CLINGS_CAN_FORK
+#define CLINGS_FINISH_TESTS() clings_finish_all()
+#else
+#define CLINGS_FINISH_TESTS() ((void)0)
+#endif
+
 /* Print test summary and return appropriate exit code */
 #define TEST_REPORT() do {                                          \
+    CLINGS_FINISH_TESTS();                                          \
     printf("\n  %d tests, %d passed, %d failed\n",                  \
         clings_tests_run, clings_tests_passed, clings_tests_failed);\
+    clings_emit_report();                                           \
     return clings_tests_failed > 0 ? 1 : 0;                        \
 } while(0)
 
@@ -110,6 +110,7 @@ TEST(test_grow_beyond_capacity) {
     ASSERT_EQ(dynarray_get(da, 1), 200);
     ASSERT_EQ(dynarray_get(da, 2), 300);
     dynarray_destroy(da);
+    ASSERT_NO_LEAKS();
 }
 
 TEST(test_get_out_of_bounds) {
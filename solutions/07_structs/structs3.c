@@ -85,6 +85,7 @@ TEST(test_push_front) {
     ASSERT(list->next->next->next == NULL);
 
     list_free(list);
+    ASSERT_NO_LEAKS();
 }
 
 TEST(test_pop_front) {
@@ -96,6 +97,7 @@ TEST(test_pop_front) {
     ASSERT_EQ(list_pop_front(&list), 10);
     ASSERT_EQ(list_pop_front(&list), -1);
     ASSERT(list == NULL);
+    ASSERT_NO_LEAKS();
 }
 
 TEST(test_find) {
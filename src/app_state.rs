@@ -126,6 +126,14 @@ impl AppState {
         false
     }
 
+    /// The exercise `next_pending` moves to once the current one is done.
+    pub fn upcoming(&self) -> Option<usize> {
+        let len = self.exercises.len();
+        (1..len)
+            .map(|i| (self.current_index + i) % len)
+            .find(|&idx| !self.done.contains(self.exercises[idx].name()))
+    }
+
     pub fn all_done(&self) -> bool {
         self.exercises.iter().all(|e| self.done.contains(e.name()))
     }
@@ -160,6 +168,11 @@ mod tests {
             sanitizers: false,
             hint: None,
             hints: None,
+            output_limit: None,
+            limits: Default::default(),
+            sanitizer: Default::default(),
+            budgets: Vec::new(),
+            isolate_tests: false,
         }
     }
 
@@ -184,6 +197,23 @@ mod tests {
 
     // --- Navigation ---
 
+    #[test]
+    fn upcoming_matches_next_pending_after_marking_done() {
+        let tmp = tempfile::tempdir().unwrap();
+        let mut state = make_state(&["a", "b", "c", "d"], tmp.path());
+        state.current_index = 2;
+        state.mark_done("d");
+        assert_eq!(state.upcoming(), Some(0));
+
+        state.mark_done("c");
+        state.next_pending();
+        assert_eq!(state.current_index, 0);
+
+        state.mark_done("a");
+        state.mark_done("b");
+        assert_eq!(state.upcoming(), None);
+    }
+
     #[test]
     fn prev_at_zero_returns_false() {
         let tmp = tempfile::tempdir().unwrap();
@@ -0,0 +1,277 @@
+use anyhow::{Context, Result};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Per-process directory for the binaries of running builds, on tmpfs
+/// where the system has one that allows executing programs:
+/// `<scratch_root>/clings-build<n>-<pid>-<random>`.
+///
+/// Every verify gets a job directory of its own, so concurrent builds of
+/// the same exercise (a cancelled watch build and its replacement, the
+/// workers of `verify --jobs`, two graded workspaces) never share a path.
+/// A job directory is removed when the job ends, the process directory
+/// when clings exits; directories left behind by a crashed clings are
+/// removed by the next one.
+///
+/// The scratch root is usually shared with other users, so the process
+/// directory is created exclusively, private to us, and under a name
+/// nobody can guess in advance.
+pub struct BuildDirs {
+    root: PathBuf,
+    counter: AtomicUsize,
+}
+
+/// Written into every process directory; `sweep_stale` removes nothing
+/// without it.
+const MARKER: &str = ".clings-build";
+
+impl BuildDirs {
+    /// `fallback` holds the builds where no tmpfs will do.
+    pub fn new(fallback: &Path) -> Result<Self> {
+        static INSTANCES: AtomicUsize = AtomicUsize::new(0);
+        let scratch = scratch_root(fallback);
+        std::fs::create_dir_all(&scratch)
+            .with_context(|| format!("Failed to create {}", scratch.display()))?;
+        sweep_stale(&scratch);
+        let n = INSTANCES.fetch_add(1, Ordering::Relaxed);
+        let root = create_private(&scratch, &format!("clings-build{n}-{}", std::process::id()))?;
+        std::fs::write(root.join(MARKER), b"")
+            .with_context(|| format!("Failed to create {}", root.display()))?;
+        Ok(Self {
+            root,
+            counter: AtomicUsize::new(0),
+        })
+    }
+
+    /// A fresh, empty directory for one job.
+    pub fn job(&self) -> Result<JobDir> {
+        let n = self.counter.fetch_add(1, Ordering::Relaxed);
+        let path = self.root.join(format!("job-{n}"));
+        std::fs::create_dir_all(&path)
+            .with_context(|| format!("Failed to create {}", path.display()))?;
+        Ok(JobDir { path })
+    }
+}
+
+impl Drop for BuildDirs {
+    fn drop(&mut self) {
+        let _ = std::fs::remove_dir_all(&self.root);
+    }
+}
+
+/// A job's build directory, removed with everything in it on drop.
+pub struct JobDir {
+    path: PathBuf,
+}
+
+impl JobDir {
+    pub fn path(&self) -> &Path {
+        &self.path
+    }
+}
+
+impl Drop for JobDir {
+    fn drop(&mut self) {
+        let _ = std::fs::remove_dir_all(&self.path);
+    }
+}
+
+/// Directory for short-lived programs: tmpfs-backed if the system has one
+/// that is not mounted `noexec` (`/dev/shm` often is), else the system's
+/// temporary directory, else `fallback`.
+pub fn scratch_root(fallback: &Path) -> PathBuf {
+    let candidates = std::env::var_os("XDG_RUNTIME_DIR")
+        .map(PathBuf::from)
+        .into_iter()
+        .chain([PathBuf::from("/dev/shm"), std::env::temp_dir()]);
+    first_executable(candidates).unwrap_or_else(|| fallback.to_path_buf())
+}
+
+fn first_executable(candidates: impl IntoIterator<Item = PathBuf>) -> Option<PathBuf> {
+    candidates.into_iter().find(|dir| dir.is_dir() && allows_exec(dir))
+}
+
+/// Whether programs can run from the filesystem `dir` is on.
+#[cfg(target_os = "linux")]
+fn allows_exec(dir: &Path) -> bool {
+    use std::os::unix::ffi::OsStrExt;
+
+    let Ok(path) = std::ffi::CString::new(dir.as_os_str().as_bytes()) else {
+        return false;
+    };
+    // SAFETY: `statvfs` is plain old data filled in on success; `path`
+    // outlives the call.
+    let mut stat: libc::statvfs = unsafe { std::mem::zeroed() };
+    if unsafe { libc::statvfs(path.as_ptr(), &mut stat) } != 0 {
+        return false;
+    }
+    stat.f_flag & libc::ST_NOEXEC == 0
+}
+
+#[cfg(not(target_os = "linux"))]
+fn allows_exec(_dir: &Path) -> bool {
+    true
+}
+
+/// Create `<dir>/<prefix>-<random>`, failing rather than reusing a path
+/// that already exists.
+fn create_private(dir: &Path, prefix: &str) -> Result<PathBuf> {
+    use std::hash::{BuildHasher, Hasher};
+
+    let mut attempts = 0;
+    loop {
+        // RandomState is seeded from the system's random source.
+        let suffix = std::collections::hash_map::RandomState::new().build_hasher().finish();
+        let path = dir.join(format!("{prefix}-{suffix:016x}"));
+        let mut builder = std::fs::DirBuilder::new();
+        #[cfg(unix)]
+        std::os::unix::fs::DirBuilderExt::mode(&mut builder, 0o700);
+        match builder.create(&path) {
+            Ok(()) => {
+                if !owned_dir(&path) {
+                    anyhow::bail!("{} is not a directory of ours", path.display());
+                }
+                return Ok(path);
+            }
+            Err(e) if e.kind() == std::io::ErrorKind::AlreadyExists && attempts < 8 => attempts += 1,
+            Err(e) => return Err(e).with_context(|| format!("Failed to create {}", path.display())),
+        }
+    }
+}
+
+/// Remove the process directories in `scratch` whose process is gone:
+/// real directories (not symlinks) of this user, with our marker inside.
+fn sweep_stale(scratch: &Path) {
+    let Ok(entries) = std::fs::read_dir(scratch) else {
+        return;
+    };
+    for entry in entries.flatten() {
+        let name = entry.file_name();
+        let Some(pid) = stale_pid(&name.to_string_lossy()) else {
+            continue;
+        };
+        let path = entry.path();
+        let marked = std::fs::symlink_metadata(path.join(MARKER)).is_ok_and(|m| m.is_file());
+        if owned_dir(&path) && marked && !process_exists(pid) {
+            let _ = std::fs::remove_dir_all(path);
+        }
+    }
+}
+
+/// The pid in a name `BuildDirs::new` creates:
+/// `clings-build<n>-<pid>-<16 hex digits>`.
+fn stale_pid(name: &str) -> Option<u32> {
+    let rest = name.strip_prefix("clings-build")?;
+    let mut parts = rest.split('-');
+    let (n, pid, suffix) = (parts.next()?, parts.next()?, parts.next()?);
+    let digits = |s: &str| !s.is_empty() && s.bytes().all(|b| b.is_ascii_digit());
+    let hex = suffix.len() == 16 && suffix.bytes().all(|b| b.is_ascii_hexdigit());
+    if parts.next().is_some() || !digits(n) || !digits(pid) || !hex {
+        return None;
+    }
+    pid.parse().ok()
+}
+
+/// Whether `path` itself, not following symlinks, is a directory owned by
+/// the current user.
+#[cfg(unix)]
+fn owned_dir(path: &Path) -> bool {
+    use std::os::unix::fs::MetadataExt;
+    // SAFETY: getuid cannot fail.
+    let uid = unsafe { libc::getuid() };
+    std::fs::symlink_metadata(path).is_ok_and(|m| m.is_dir() && m.uid() == uid)
+}
+
+#[cfg(not(unix))]
+fn owned_dir(path: &Path) -> bool {
+    std::fs::symlink_metadata(path).is_ok_and(|m| m.is_dir())
+}
+
+#[cfg(unix)]
+fn process_exists(pid: u32) -> bool {
+    let Ok(pid) = libc::pid_t::try_from(pid) else {
+        return true;
+    };
+    // SAFETY: signal 0 only checks whether the process exists.
+    let rc = unsafe { libc::kill(pid, 0) };
+    rc == 0 || std::io::Error::last_os_error().raw_os_error() != Some(libc::ESRCH)
+}
+
+#[cfg(not(unix))]
+fn process_exists(_pid: u32) -> bool {
+    true
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn scratch_root_exists() {
+        let fallback = Path::new("/nonexistent");
+        assert!(scratch_root(fallback).is_dir());
+        let missing = [PathBuf::from("/nonexistent"), PathBuf::from("/etc/hostname")];
+        assert_eq!(first_executable(missing), None);
+        assert!(allows_exec(&std::env::temp_dir()));
+    }
+
+    #[test]
+    fn jobs_are_separate_and_cleaned_up() {
+        let dirs = BuildDirs::new(&std::env::temp_dir()).unwrap();
+        let a = dirs.job().unwrap();
+        let b = dirs.job().unwrap();
+        assert_ne!(a.path(), b.path());
+        std::fs::write(a.path().join("bin"), b"x").unwrap();
+
+        let (a_path, root) = (a.path().to_path_buf(), dirs.root.clone());
+        drop(a);
+        assert!(!a_path.exists());
+        assert!(b.path().is_dir());
+        drop(b);
+        drop(dirs);
+        assert!(!root.exists());
+    }
+
+    #[test]
+    fn stale_pids_are_parsed() {
+        assert_eq!(stale_pid("clings-build0-123-00ff00ff00ff00ff"), Some(123));
+        assert_eq!(stale_pid("clings-build0-123"), None);
+        assert_eq!(stale_pid("clings-build0-123-00ff00ff00ff00ff-x"), None);
+        assert_eq!(stale_pid("clings-build0-123-not-hex"), None);
+        assert_eq!(stale_pid("clings-warm-123"), None);
+        assert_eq!(stale_pid("clings-build"), None);
+        assert_eq!(stale_pid("other-123"), None);
+    }
+
+    #[test]
+    fn sweep_removes_only_marked_directories() {
+        let scratch = tempfile::tempdir().unwrap();
+        // Above any pid_max, so no process has it.
+        let dead = format!("clings-build0-{}", i32::MAX);
+        let marked = create_private(scratch.path(), &dead).unwrap();
+        std::fs::write(marked.join(MARKER), b"").unwrap();
+        let unmarked = create_private(scratch.path(), &dead).unwrap();
+        #[cfg(unix)]
+        let link = {
+            let link = scratch.path().join(format!("{dead}-0123456789abcdef"));
+            std::os::unix::fs::symlink(&marked, &link).unwrap();
+            link
+        };
+
+        sweep_stale(scratch.path());
+        assert!(!marked.exists());
+        assert!(unmarked.is_dir());
+        #[cfg(unix)]
+        assert!(std::fs::symlink_metadata(link).is_ok());
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn process_directory_is_private() {
+        use std::os::unix::fs::PermissionsExt;
+        let dirs = BuildDirs::new(&std::env::temp_dir()).unwrap();
+        let mode = std::fs::metadata(&dirs.root).unwrap().permissions().mode();
+        assert_eq!(mode & 0o777, 0o700);
+        assert!(stale_pid(&dirs.root.file_name().unwrap().to_string_lossy()).is_some());
+    }
+}
@@ -0,0 +1,229 @@
+use anyhow::{Context, Result};
+use sha2::{Digest, Sha256};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Entries kept before the least recently used ones are pruned.
+const MAX_ENTRIES: usize = 512;
+
+const OUTPUT_FILE: &str = "output.txt";
+const BINARY_FILE: &str = "bin";
+
+/// SHA-256 hasher used for cache keys.
+///
+/// `std::hash` makes no stability promise across releases, and these keys
+/// are persisted on disk. The cache can be shared by several workspaces,
+/// so a key must not be forgeable by crafting a colliding source.
+pub struct Fingerprint(Sha256);
+
+impl Fingerprint {
+    pub fn new() -> Self {
+        Self(Sha256::new())
+    }
+
+    /// Feed one length-prefixed field, so `["ab", "c"]` and `["a", "bc"]`
+    /// hash differently.
+    pub fn update(&mut self, bytes: &[u8]) -> &mut Self {
+        self.write(&(bytes.len() as u64).to_le_bytes());
+        self.write(bytes);
+        self
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        self.0.update(bytes);
+    }
+
+    pub fn hex(&self) -> String {
+        self.0.clone().finalize().iter().map(|b| format!("{b:02x}")).collect()
+    }
+}
+
+/// A compiler run restored from the cache.
+pub struct CachedBuild {
+    pub success: bool,
+    pub output: String,
+}
+
+/// Content-addressed store of compiler results under `target/clings/cache`.
+///
+/// Each entry is a directory named by its key holding the diagnostics and,
+/// for successful builds, the binary. Builds run in a job directory
+/// (`BuildDirs`) and are only stored here once they proved useful. The
+/// diagnostics file's mtime is the entry's last use, refreshed on every
+/// hit.
+pub struct BuildCache {
+    dir: PathBuf,
+}
+
+impl BuildCache {
+    pub fn new(dir: PathBuf) -> Self {
+        Self { dir }
+    }
+
+    /// Look up `key` and, on a hit, place the cached binary at `output`.
+    pub fn restore(&self, key: &str, output: &Path) -> Option<CachedBuild> {
+        let entry = self.dir.join(key);
+        let diagnostics = std::fs::read_to_string(entry.join(OUTPUT_FILE)).ok()?;
+        let binary = entry.join(BINARY_FILE);
+        let success = binary.exists();
+        if success && link_or_copy(&binary, output).is_err() {
+            return None;
+        }
+        touch(&entry.join(OUTPUT_FILE));
+        Some(CachedBuild {
+            success,
+            output: diagnostics,
+        })
+    }
+
+    /// Record a finished build as the entry for `key`: its diagnostics and,
+    /// for a successful build, a copy of its binary.
+    pub fn store(&self, key: &str, binary: Option<&Path>, output_text: &str) -> Result<()> {
+        static COUNTER: AtomicUsize = AtomicUsize::new(0);
+        let entry = self.dir.join(key);
+        if entry.exists() {
+            touch(&entry.join(OUTPUT_FILE));
+            return Ok(());
+        }
+        let n = COUNTER.fetch_add(1, Ordering::Relaxed);
+        let scratch = self
+            .dir
+            .join(format!(".{key}.{}.{n}", std::process::id()));
+        std::fs::create_dir_all(&scratch)
+            .with_context(|| format!("Failed to create {}", scratch.display()))?;
+        let written = std::fs::write(scratch.join(OUTPUT_FILE), output_text).and_then(|()| match binary {
+            Some(binary) => link_or_copy(binary, &scratch.join(BINARY_FILE)),
+            None => Ok(()),
+        });
+        // Renaming last means other builds never see a half-written entry;
+        // if another build stored the same key first, keep that one.
+        if written.is_err() || std::fs::rename(&scratch, &entry).is_err() {
+            let _ = std::fs::remove_dir_all(&scratch);
+        }
+        written.with_context(|| format!("Failed to store {}", entry.display()))
+    }
+
+    /// Remove the least recently used entries once the cache grows past
+    /// `MAX_ENTRIES`.
+    pub fn prune(&self) {
+        let Ok(read_dir) = std::fs::read_dir(&self.dir) else {
+            return;
+        };
+        let mut entries: Vec<_> = read_dir
+            .filter_map(|e| e.ok())
+            .filter(|e| !e.file_name().to_string_lossy().starts_with('.'))
+            .filter_map(|e| {
+                let used = std::fs::metadata(e.path().join(OUTPUT_FILE))
+                    .and_then(|m| m.modified())
+                    .ok()?;
+                Some((used, e.path()))
+            })
+            .collect();
+        if entries.len() <= MAX_ENTRIES {
+            return;
+        }
+        entries.sort();
+        let excess = entries.len() - MAX_ENTRIES;
+        for (_, path) in entries.into_iter().take(excess) {
+            let _ = std::fs::remove_dir_all(path);
+        }
+    }
+}
+
+/// Mark an entry as used now. Pruning only gets less accurate if this
+/// fails, so errors are ignored.
+fn touch(path: &Path) {
+    let _ = std::fs::File::options()
+        .write(true)
+        .open(path)
+        .and_then(|f| f.set_modified(std::time::SystemTime::now()));
+}
+
+/// Hard-link `from` to `to`, falling back to a copy across filesystems.
+fn link_or_copy(from: &Path, to: &Path) -> std::io::Result<()> {
+    match std::fs::remove_file(to) {
+        Ok(()) => {}
+        Err(e) if e.kind() == std::io::ErrorKind::NotFound => {}
+        Err(e) => return Err(e),
+    }
+    if std::fs::hard_link(from, to).is_err() {
+        std::fs::copy(from, to)?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn fingerprint_is_stable() {
+        assert_eq!(
+            Fingerprint::new().hex(),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+        );
+        let a = Fingerprint::new().update(b"abc").hex();
+        let b = Fingerprint::new().update(b"abc").hex();
+        assert_eq!(a, b);
+    }
+
+    #[test]
+    fn fingerprint_fields_are_delimited() {
+        let a = Fingerprint::new().update(b"ab").update(b"c").hex();
+        let b = Fingerprint::new().update(b"a").update(b"bc").hex();
+        assert_ne!(a, b);
+    }
+
+    #[test]
+    fn miss_on_empty_cache() {
+        let tmp = tempfile::tempdir().unwrap();
+        let cache = BuildCache::new(tmp.path().join("cache"));
+        assert!(cache.restore("deadbeef", &tmp.path().join("out")).is_none());
+    }
+
+    #[test]
+    fn store_then_restore_success() {
+        let tmp = tempfile::tempdir().unwrap();
+        let cache = BuildCache::new(tmp.path().join("cache"));
+        let built = tmp.path().join("built");
+        std::fs::write(&built, b"binary").unwrap();
+        cache.store("k1", Some(&built), "warning: x").unwrap();
+
+        let out = tmp.path().join("out");
+        let hit = cache.restore("k1", &out).unwrap();
+        assert!(hit.success);
+        assert_eq!(hit.output, "warning: x");
+        assert_eq!(std::fs::read(&out).unwrap(), b"binary");
+    }
+
+    #[test]
+    fn store_then_restore_failure() {
+        let tmp = tempfile::tempdir().unwrap();
+        let cache = BuildCache::new(tmp.path().join("cache"));
+        cache.store("k2", None, "error: y").unwrap();
+        let out = tmp.path().join("out");
+        let hit = cache.restore("k2", &out).unwrap();
+        assert!(!hit.success);
+        assert_eq!(hit.output, "error: y");
+        assert!(!out.exists());
+    }
+
+    #[test]
+    fn prune_keeps_recently_used_entries() {
+        let tmp = tempfile::tempdir().unwrap();
+        let cache = BuildCache::new(tmp.path().join("cache"));
+        let long_ago = std::time::SystemTime::now() - std::time::Duration::from_secs(3600);
+        for i in 0..=MAX_ENTRIES {
+            let key = format!("k{i}");
+            cache.store(&key, None, "").unwrap();
+            let output = tmp.path().join("cache").join(&key).join(OUTPUT_FILE);
+            let file = std::fs::File::options().write(true).open(output).unwrap();
+            file.set_modified(long_ago + std::time::Duration::from_secs(i as u64)).unwrap();
+        }
+        // The oldest entry is hit, so the second oldest goes instead.
+        assert!(cache.restore("k0", &tmp.path().join("out")).is_some());
+        cache.prune();
+        assert!(cache.restore("k0", &tmp.path().join("out")).is_some());
+        assert!(cache.restore("k1", &tmp.path().join("out")).is_none());
+    }
+}
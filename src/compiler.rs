@@ -1,4 +1,11 @@
+use crate::build_dirs::{BuildDirs, JobDir};
+use crate::cache::{BuildCache, Fingerprint};
+use crate::info_file::ExerciseInfo;
+use crate::pch::{self, PchStore};
+use crate::probe::{self, Capabilities};
+use crate::proc::{self, Cancel, Usage};
 use anyhow::{Context, Result};
+use std::ffi::OsStr;
 use std::path::{Path, PathBuf};
 use std::process::Command;
 
@@ -26,33 +33,61 @@ impl std::fmt::Display for CompilerKind {
 pub struct CompileResult {
     pub success: bool,
     pub output: String,
+    pub usage: Usage,
+    /// Restored from the build cache without running the compiler.
+    pub cached: bool,
+    /// Cache key of a fresh build, for `Compiler::promote`.
+    key: Option<String>,
+    /// Per-phase breakdown of `usage`, for builds split into phases.
+    pub phases: Option<Phases>,
+}
+
+/// Usage of the three phases of a split build (see `split_phases`).
+#[derive(Debug, Clone, Copy, Default)]
+pub struct Phases {
+    pub preprocess: Usage,
+    pub compile: Usage,
+    pub link: Usage,
 }
 
 pub struct Compiler {
     kind: CompilerKind,
+    caps: Capabilities,
     include_dir: PathBuf,
+    cache: BuildCache,
+    pch: PchStore,
+    dirs: BuildDirs,
+    split: bool,
 }
 
 impl Compiler {
     pub fn new(kind: CompilerKind, base_dir: &Path) -> Result<Self> {
-        let name = kind.command_name();
-        let status = Command::new(name)
-            .arg("--version")
-            .stdout(std::process::Stdio::null())
-            .stderr(std::process::Stdio::null())
-            .status()
-            .with_context(|| format!("{name} not found. Please install it."))?;
-
-        if !status.success() {
-            anyhow::bail!("{name} --version failed");
-        }
+        let build_dir = base_dir.join("target").join("clings");
+        let caps = Capabilities::load_or_probe(kind, &build_dir)?;
+
+        let cache = BuildCache::new(build_dir.join("cache"));
+        cache.prune();
 
         Ok(Self {
             kind,
+            caps,
             include_dir: base_dir.join("include"),
+            cache,
+            pch: PchStore::new(build_dir.join("pch")),
+            dirs: BuildDirs::new(&build_dir.join("builds"))?,
+            split: false,
         })
     }
 
+    /// Build in three steps (preprocess, compile to an object, link) and
+    /// time each one, instead of one driver call.
+    ///
+    /// Costs two extra process starts per build and skips the precompiled
+    /// header, so it is for `--timings` only.
+    pub fn split_phases(&mut self) {
+        self.split = true;
+    }
+
     pub fn kind(&self) -> CompilerKind {
         self.kind
     }
@@ -71,78 +106,341 @@ impl Compiler {
             "-std=c11".into(),
             "-g".into(),
         ];
-        if self.supports_flag("-fno-diagnostics-show-fix-it-hints") {
-            args.push("-fno-diagnostics-show-fix-it-hints".into());
+        args.extend(
+            probe::OPTIONAL_FLAGS
+                .iter()
+                .filter(|flag| self.caps.supports(flag))
+                .map(|flag| flag.to_string()),
+        );
+        args
+    }
+
+    fn test_args(&self) -> Vec<String> {
+        let mut args = self.base_args();
+        args.push("-DTEST".into());
+        if self.caps.wrap_allocs {
+            args.push("-DCLINGS_TRACK_ALLOCS".into());
+            args.push(probe::WRAP_ALLOC_FLAG.into());
         }
         args
     }
 
-    fn supports_flag(&self, flag: &str) -> bool {
-        Command::new(self.kind.command_name())
-            .args([flag, "-x", "c", "-E", "-"])
-            .stdin(std::process::Stdio::null())
-            .stdout(std::process::Stdio::null())
-            .stderr(std::process::Stdio::null())
-            .status()
-            .map(|s| s.success())
-            .unwrap_or(false)
+    /// The sanitized program runs the exercise's tests, like the test
+    /// build, so the sanitizers see the same inputs the tests check.
+    fn sanitizer_args(&self) -> Vec<String> {
+        vec![
+            self.include_flag(),
+            probe::SANITIZE_FLAG.into(),
+            "-fno-sanitize-recover=all".into(),
+            "-g".into(),
+            "-std=c11".into(),
+            "-DTEST".into(),
+        ]
     }
 
-    pub fn compile(&self, source: &Path, output: &Path) -> Result<CompileResult> {
-        let mut args = self.base_args();
-        args.push("-o".into());
-        args.push(output.to_str().unwrap().into());
-        args.push(source.to_str().unwrap().into());
+    /// The installed compiler binary (path, size and mtime), as probed.
+    pub fn identity(&self) -> &str {
+        &self.caps.stamp
+    }
 
-        self.run_compiler(&args)
+    /// Every flag `Exercise::verify` passes when building `info`, one flag
+    /// set after another, with an empty entry between sets.
+    pub fn verify_flags(&self, info: &ExerciseInfo) -> Vec<String> {
+        let mut flags = self.base_args();
+        if info.test {
+            flags.push(String::new());
+            flags.extend(self.test_args());
+        }
+        if info.sanitizers {
+            flags.push(String::new());
+            flags.extend(self.sanitizer_args());
+        }
+        flags
     }
 
-    pub fn compile_with_tests(&self, source: &Path, output: &Path) -> Result<CompileResult> {
-        let mut args = self.base_args();
-        args.push("-DTEST".into());
-        args.push("-o".into());
-        args.push(output.to_str().unwrap().into());
-        args.push(source.to_str().unwrap().into());
+    pub fn compile(
+        &self,
+        source: &Path,
+        output: &Path,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        let args = self.base_args();
+        self.build(args, source, output, false, cancel)
+    }
 
-        self.run_compiler(&args)
+    pub fn compile_with_tests(
+        &self,
+        source: &Path,
+        output: &Path,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        let args = self.test_args();
+        self.build(args, source, output, true, cancel)
     }
 
-    pub fn compile_with_sanitizers(&self, source: &Path, output: &Path) -> Result<CompileResult> {
-        let args = vec![
-            self.include_flag(),
-            "-fsanitize=address,undefined".into(),
-            "-fno-sanitize-recover=all".into(),
-            "-g".into(),
-            "-std=c11".into(),
-            "-o".into(),
-            output.to_str().unwrap().into(),
-            source.to_str().unwrap().into(),
-        ];
+    pub fn compile_with_sanitizers(
+        &self,
+        source: &Path,
+        output: &Path,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        if !self.caps.sanitizers {
+            return Ok(CompileResult {
+                success: false,
+                output: format!(
+                    "{} cannot build programs with {} on this system.\n",
+                    self.kind,
+                    probe::SANITIZE_FLAG
+                ),
+                usage: Usage::default(),
+                cached: false,
+                key: None,
+                phases: None,
+            });
+        }
+        let args = self.sanitizer_args();
+        self.build(args, source, output, false, cancel)
+    }
 
-        self.run_compiler(&args)
+    /// Trim the build cache back to its size limit.
+    pub fn prune_cache(&self) {
+        self.cache.prune();
     }
 
-    fn run_compiler(&self, args: &[String]) -> Result<CompileResult> {
-        let output = Command::new(self.kind.command_name())
-            .args(args)
-            .output()
-            .with_context(|| format!("Failed to run {}", self.kind))?;
+    /// A fresh directory to build one exercise in; see `BuildDirs`.
+    pub fn job_dir(&self) -> Result<JobDir> {
+        self.dirs.job()
+    }
 
-        let mut combined = String::new();
-        if !output.stdout.is_empty() {
-            combined.push_str(&String::from_utf8_lossy(&output.stdout));
+    /// Store a fresh build whose result turned out to matter in the build
+    /// cache. `binary` is where it was built.
+    pub fn promote(&self, result: &CompileResult, binary: &Path) -> Result<()> {
+        match &result.key {
+            Some(key) => self
+                .cache
+                .store(key, result.success.then_some(binary), &result.output),
+            None => Ok(()),
         }
-        if !output.stderr.is_empty() {
-            combined.push_str(&String::from_utf8_lossy(&output.stderr));
+    }
+
+    /// Compile `source` with `flags` into `output`, reusing a cached build
+    /// when the source, flags, compiler and test harness are all unchanged.
+    /// Where the source lives does not matter (see `source_location`), so
+    /// identical submissions in different workspaces share builds.
+    /// With `use_pch` the test harness comes from a precompiled header if
+    /// the source `fits` one. The result is not cached until it is
+    /// promoted.
+    fn build(
+        &self,
+        flags: Vec<String>,
+        source: &Path,
+        output: &Path,
+        use_pch: bool,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        let source_bytes = std::fs::read(source)
+            .with_context(|| format!("Failed to read {}", source.display()))?;
+        let harness = self.harness();
+        let key = self.cache_key(&flags, source_location(source).1, &source_bytes, &harness);
+        if let Some(hit) = self.cache.restore(&key, output) {
+            return Ok(CompileResult {
+                success: hit.success,
+                output: hit.output,
+                usage: Usage::default(),
+                cached: true,
+                key: None,
+                phases: None,
+            });
+        }
+
+        if self.split {
+            return self.run_phases(&flags, source, output, cancel).map(|r| CompileResult {
+                key: Some(key),
+                ..r
+            });
         }
 
+        let pch_flags = if use_pch && pch::fits(&source_bytes) {
+            self.pch
+                .flags_for(self.kind, &self.caps.version, &flags, &harness)
+        } else {
+            None
+        };
+        let result = match pch_flags {
+            Some(pch_flags) => {
+                let with_pch = [flags.as_slice(), &pch_flags].concat();
+                let first = self.run_compiler(&with_pch, source, output, cancel)?;
+                if first.success || !pch::refused(&first.output) {
+                    first
+                } else {
+                    // A stale or rejected PCH must never change the verdict:
+                    // the plain compile is authoritative. Errors in the
+                    // exercise itself are reported as they are.
+                    let r = self.run_compiler(&flags, source, output, cancel)?;
+                    if r.success {
+                        self.pch.reject(&pch_flags);
+                    }
+                    CompileResult {
+                        usage: first.usage.add(r.usage),
+                        ..r
+                    }
+                }
+            }
+            None => self.run_compiler(&flags, source, output, cancel)?,
+        };
+
+        Ok(CompileResult {
+            key: Some(key),
+            ..result
+        })
+    }
+
+    /// Contents of `include/clings_test.h`. A missing harness is a compile
+    /// error for the exercise, not an error here.
+    pub fn harness(&self) -> Vec<u8> {
+        std::fs::read(self.include_dir.join("clings_test.h")).unwrap_or_default()
+    }
+
+    /// `name` is the source's path relative to where it is compiled from.
+    fn cache_key(&self, flags: &[String], name: &Path, source_bytes: &[u8], harness: &[u8]) -> String {
+        let mut fp = Fingerprint::new();
+        fp.update(self.caps.version.as_bytes());
+        // The same version string can name a rebuilt or different binary.
+        fp.update(self.caps.stamp.as_bytes());
+        for flag in flags {
+            fp.update(flag.as_bytes());
+        }
+        fp.update(name.as_os_str().as_encoded_bytes());
+        fp.update(source_bytes);
+        fp.update(harness);
+        fp.hex()
+    }
+
+    /// The compiler, run from `root` (see `source_location`) with debug
+    /// info naming files relative to it.
+    fn driver(&self, root: &Path) -> Command {
+        let mut cmd = Command::new(self.kind.command_name());
+        cmd.current_dir(root)
+            .arg(format!("-fdebug-prefix-map={}=.", root.display()));
+        cmd
+    }
+
+    fn run_compiler(
+        &self,
+        flags: &[String],
+        source: &Path,
+        binary: &Path,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        let (root, name) = source_location(source);
+        let output = proc::run(
+            self.driver(root)
+                .args(flags)
+                .arg("-o")
+                .arg(binary)
+                .arg(name),
+            cancel,
+        )
+        .with_context(|| format!("Failed to run {}", self.kind))?;
+
+        let mut combined = String::new();
+        append_output(&mut combined, &output);
+
         Ok(CompileResult {
             success: output.status.success(),
             output: combined,
+            usage: output.usage,
+            cached: false,
+            key: None,
+            phases: None,
+        })
+    }
+
+    /// `run_compiler` in three driver calls: `-E` to `<binary>.i`, `-c` of
+    /// that to `<binary>.o`, then the link. The flags go to every step;
+    /// the driver ignores those that do not apply, and the sanitizer flag
+    /// must reach the link. Stops at the first failing step.
+    fn run_phases(
+        &self,
+        flags: &[String],
+        source: &Path,
+        binary: &Path,
+        cancel: Option<&Cancel>,
+    ) -> Result<CompileResult> {
+        let (root, name) = source_location(source);
+        let preprocessed = binary.with_extension("i");
+        let object = binary.with_extension("o");
+        let steps: [(&[&OsStr], &Path, &Path); 3] = [
+            (&["-E".as_ref()], &preprocessed, name),
+            (&["-x".as_ref(), "cpp-output".as_ref(), "-c".as_ref()], &object, &preprocessed),
+            (&[], binary, &object),
+        ];
+
+        let mut combined = String::new();
+        let mut usages = [Usage::default(); 3];
+        let mut success = true;
+        for ((step_flags, out, input), usage) in steps.iter().zip(&mut usages) {
+            let output = proc::run(
+                self.driver(root)
+                    .args(flags)
+                    .args(*step_flags)
+                    .arg("-o")
+                    .arg(out)
+                    .arg(input),
+                cancel,
+            )
+            .with_context(|| format!("Failed to run {}", self.kind))?;
+            append_output(&mut combined, &output);
+            *usage = output.usage;
+            if !output.status.success() {
+                success = false;
+                break;
+            }
+        }
+        let _ = std::fs::remove_file(&preprocessed);
+        let _ = std::fs::remove_file(&object);
+
+        let [preprocess, compile, link] = usages;
+        Ok(CompileResult {
+            success,
+            output: combined,
+            usage: preprocess.add(compile).add(link),
+            cached: false,
+            key: None,
+            phases: Some(Phases {
+                preprocess,
+                compile,
+                link,
+            }),
         })
     }
 }
 
+/// Where to compile `source` from, and its path relative to that.
+///
+/// Exercises live at `<workspace>/exercises/<dir>/<name>.c` and are
+/// compiled from the workspace as `exercises/<dir>/<name>.c`, so
+/// diagnostics and `__FILE__` read the same in every workspace and a build
+/// can be reused for any copy of the same source.
+fn source_location(source: &Path) -> (&Path, &Path) {
+    match source.ancestors().nth(3) {
+        Some(root) if !root.as_os_str().is_empty() => {
+            (root, source.strip_prefix(root).unwrap_or(source))
+        }
+        _ => (Path::new("."), source),
+    }
+}
+
+/// Append a compiler's stdout and stderr to `combined`.
+fn append_output(combined: &mut String, output: &proc::ProcOutput) {
+    if !output.stdout.is_empty() {
+        combined.push_str(&String::from_utf8_lossy(&output.stdout));
+    }
+    if !output.stderr.is_empty() {
+        combined.push_str(&String::from_utf8_lossy(&output.stderr));
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -157,6 +455,15 @@ mod tests {
         assert_eq!(CompilerKind::Clang.command_name(), "clang");
     }
 
+    #[test]
+    fn sources_are_named_from_their_workspace() {
+        let (root, name) = source_location(Path::new("/home/ann/ws/exercises/01_pointers/p1.c"));
+        assert_eq!(root, Path::new("/home/ann/ws"));
+        assert_eq!(name, Path::new("exercises/01_pointers/p1.c"));
+        let (root, name) = source_location(Path::new("ex/p1.c"));
+        assert_eq!((root, name), (Path::new("."), Path::new("ex/p1.c")));
+    }
+
     #[test]
     fn display_trait() {
         assert_eq!(format!("{}", CompilerKind::Gcc), "gcc");
@@ -1,9 +1,14 @@
-use crate::compiler::Compiler;
-use crate::info_file::ExerciseInfo;
+use crate::compiler::{CompileResult, Compiler, Phases};
+use crate::harness_report::{self, Report, TestRecord};
+use crate::info_file::{ExerciseInfo, Limits, SanitizerProfile};
+use crate::proc::{self, Cancel, RunLimits, Usage};
+use crate::sandbox;
 use anyhow::Result;
 use std::path::{Path, PathBuf};
 use std::process::Command;
+use std::time::Duration;
 
+#[derive(Clone)]
 pub struct Exercise {
     pub info: ExerciseInfo,
     pub path: PathBuf,
@@ -11,10 +16,117 @@ pub struct Exercise {
     pub solution_path: PathBuf,
 }
 
+/// Bytes of output kept per program run unless `output_limit` says otherwise.
+const DEFAULT_OUTPUT_LIMIT: usize = 64 * 1024;
+
+/// Number of tests `clings_test.h` runs in forked children at once; `0`
+/// means one per core.
+const TEST_JOBS_ENV: &str = "CLINGS_TEST_JOBS";
+
+/// Seconds each forked test may take in `clings_test.h`.
+const TEST_TIMEOUT_ENV: &str = "CLINGS_TEST_TIMEOUT";
+
+/// Limits for fields that neither the exercise nor `[limits]` set.
+const DEFAULT_LIMITS: Limits = Limits {
+    timeout_secs: Some(10.0),
+    cpu_secs: Some(10),
+    memory_mb: Some(1024),
+    file_size_mb: Some(64),
+    processes: None,
+};
+
+/// Sanitizer options for fields that neither the exercise nor
+/// `[sanitizer]` set. Leak checking stays on, so no bug goes unreported
+/// unless an exercise opts out; allocation stacks are shorter than ASan's
+/// 30 frames, which is plenty for programs this size.
+const DEFAULT_SANITIZER: SanitizerProfile = SanitizerProfile {
+    detect_leaks: Some(true),
+    malloc_context_size: Some(10),
+    print_stacktrace: Some(false),
+};
+
 pub struct VerifyResult {
     pub success: bool,
     pub stage: &'static str,
     pub output: String,
+    /// One entry per stage that ran, in stage order.
+    pub timings: Vec<StageTiming>,
+    /// Reused from the verdict store; nothing was built or run.
+    pub cached: bool,
+    /// Per-test results reported by the test harness, once the tests ran.
+    pub tests: Vec<TestRecord>,
+}
+
+impl VerifyResult {
+    /// A pass carried over from an earlier run with identical inputs.
+    pub fn cached_pass() -> Self {
+        Self {
+            success: true,
+            stage: "complete",
+            output: String::new(),
+            timings: Vec::new(),
+            cached: true,
+            tests: Vec::new(),
+        }
+    }
+}
+
+/// Time and memory spent in one verify stage.
+#[derive(Debug, Clone, Copy)]
+pub struct StageTiming {
+    pub stage: &'static str,
+    pub usage: Usage,
+    /// A compile stage served from the build cache.
+    pub cached: bool,
+    /// Breakdown of a compile stage built with `Compiler::split_phases`.
+    pub phases: Option<Phases>,
+}
+
+impl StageTiming {
+    fn compile(stage: &'static str, result: &CompileResult) -> Self {
+        Self {
+            stage,
+            usage: result.usage,
+            cached: result.cached,
+            phases: result.phases,
+        }
+    }
+
+    fn run(stage: &'static str, result: &RunResult) -> Self {
+        Self {
+            stage,
+            usage: result.usage,
+            cached: false,
+            phases: None,
+        }
+    }
+
+    /// Short form for one-line summaries, e.g. `tests 12ms` or
+    /// `compilation 58ms (cpp 14 + cc 29 + ld 15)`.
+    pub fn compact(&self) -> String {
+        if self.cached {
+            return format!("{} cached", self.stage);
+        }
+        let mut s = format!("{} {}ms", self.stage, self.usage.wall.as_millis());
+        if let Some(p) = &self.phases {
+            s.push_str(&format!(
+                " (cpp {} + cc {} + ld {})",
+                p.preprocess.wall.as_millis(),
+                p.compile.wall.as_millis(),
+                p.link.wall.as_millis()
+            ));
+        }
+        s
+    }
+}
+
+/// All stages on one line, e.g. `compilation 41ms · execution 2ms`.
+pub fn compact_timings(timings: &[StageTiming]) -> String {
+    timings
+        .iter()
+        .map(StageTiming::compact)
+        .collect::<Vec<_>>()
+        .join(" · ")
 }
 
 impl Exercise {
@@ -40,105 +152,367 @@ impl Exercise {
         self.path.exists()
     }
 
-    pub fn verify(&self, compiler: &Compiler, build_dir: &Path) -> Result<VerifyResult> {
-        std::fs::create_dir_all(build_dir)?;
-
-        let bin_path = build_dir.join(&self.info.name);
+    /// Limits for one run of a program built from this exercise. ASan
+    /// reserves terabytes of address space up front, so `sanitized`
+    /// programs get no address-space limit.
+    fn run_limits(&self, sanitized: bool) -> RunLimits {
+        let limits = self.info.limits.or(DEFAULT_LIMITS);
+        let set = |value: Option<u64>| value.filter(|&v| v > 0);
+        let mib = |value: Option<u64>| set(value).map(|mb| mb.saturating_mul(1 << 20));
+        RunLimits {
+            timeout: limits
+                .timeout_secs
+                .filter(|&secs| secs > 0.0)
+                .and_then(|secs| Duration::try_from_secs_f64(secs).ok()),
+            cpu_secs: set(limits.cpu_secs),
+            address_space: if sanitized { None } else { mib(limits.memory_mb) },
+            file_size: mib(limits.file_size_mb),
+            processes: set(limits.processes),
+            sandbox: sandbox::enabled(),
+        }
+    }
 
-        // Step 1: Compile
-        let result = compiler.compile(&self.path, &bin_path)?;
-        if !result.success {
-            return Ok(VerifyResult {
-                success: false,
-                stage: "compilation",
-                output: result.output,
-            });
+    /// Pass the sanitizer profile to a sanitized program. Options already
+    /// in the environment come last, so they still win.
+    fn sanitizer_env(&self, cmd: &mut Command) {
+        let profile = self.info.sanitizer.or(DEFAULT_SANITIZER);
+        let flag = |on: Option<bool>| u8::from(on.unwrap_or(false));
+        let mut asan = format!("detect_leaks={}", flag(profile.detect_leaks));
+        if let Some(frames) = profile.malloc_context_size {
+            asan.push_str(&format!(":malloc_context_size={frames}"));
         }
+        let ubsan = format!("print_stacktrace={}", flag(profile.print_stacktrace));
+        for (var, ours) in [("ASAN_OPTIONS", asan), ("UBSAN_OPTIONS", ubsan)] {
+            let value = match std::env::var(var) {
+                Ok(theirs) if !theirs.is_empty() => format!("{ours}:{theirs}"),
+                _ => ours,
+            };
+            cmd.env(var, value);
+        }
+    }
 
-        // Step 2: Run the binary
-        let run_result = run_binary(&bin_path)?;
-        if !run_result.success {
-            return Ok(VerifyResult {
-                success: false,
-                stage: "execution",
-                output: run_result.output,
-            });
+    /// Run a program built from this exercise, with its limits and output
+    /// cap. Outside the sanitizer stage the test harness reports its
+    /// results, which are kept apart from the output so the cap cannot cut
+    /// them; exercises with `isolate_tests` have it fork a child per test.
+    fn run_program(&self, path: &Path, cancel: Option<&Cancel>, sanitized: bool) -> Result<RunResult> {
+        let limits = self.run_limits(sanitized);
+        let mut capture = proc::Capture::new(self.info.output_limit.unwrap_or(DEFAULT_OUTPUT_LIMIT));
+        let mut cmd = Command::new(path);
+        if sanitized {
+            self.sanitizer_env(&mut cmd);
         }
-        let run_output = run_result.output.clone();
-
-        // Step 3: Compile and run with tests (if enabled)
-        if self.info.test {
-            let test_bin = build_dir.join(format!("{}_test", self.info.name));
-            let result = compiler.compile_with_tests(&self.path, &test_bin)?;
-            if !result.success {
-                return Ok(VerifyResult {
-                    success: false,
-                    stage: "test compilation",
-                    output: result.output,
-                });
+        if !sanitized {
+            // The sanitizer stage shows its output as is.
+            capture = capture.report_pipe(harness_report::REPORT_ENV);
+        }
+        if self.info.isolate_tests {
+            // One child per core at a time.
+            cmd.env(TEST_JOBS_ENV, "0");
+            if let Some(timeout) = limits.timeout {
+                cmd.env(TEST_TIMEOUT_ENV, test_timeout(timeout, std::env::var(TEST_TIMEOUT_ENV).ok()));
             }
+        }
+        let outcome = proc::run_captured(&mut cmd, cancel, &limits, &capture)?;
+        let mut output = capture.text();
+        let (records, dropped) = capture.records();
 
-            let test_result = run_binary(&test_bin)?;
-            if !test_result.success {
-                return Ok(VerifyResult {
-                    success: false,
-                    stage: "tests",
-                    output: test_result.output,
-                });
+        let cpu_exceeded = exceeded_cpu(&outcome.status);
+        let note = if outcome.timed_out {
+            limits
+                .timeout
+                .map(|t| format!("Killed after {:.1} s of wall-clock time (timeout_secs).", t.as_secs_f64()))
+        } else if cpu_exceeded {
+            limits
+                .cpu_secs
+                .map(|secs| format!("Killed after {secs} s of CPU time (cpu_secs)."))
+        } else {
+            None
+        };
+        let dropped_note = (dropped > 0).then(|| {
+            format!("{dropped} test report line(s) dropped (too long or too many); per-test results are incomplete.")
+        });
+        for note in note.into_iter().chain(dropped_note) {
+            if !output.is_empty() && !output.ends_with('\n') {
+                output.push('\n');
             }
+            output.push_str(&note);
+            output.push('\n');
         }
 
-        // Step 4: Compile and run with sanitizers (if enabled)
-        if self.info.sanitizers {
-            let san_bin = build_dir.join(format!("{}_san", self.info.name));
-            let result = compiler.compile_with_sanitizers(&self.path, &san_bin)?;
-            if !result.success {
-                return Ok(VerifyResult {
-                    success: false,
-                    stage: "sanitizer compilation",
-                    output: result.output,
-                });
+        Ok(RunResult {
+            success: outcome.status.success(),
+            output,
+            records,
+            usage: outcome.usage,
+            timed_out: outcome.timed_out || cpu_exceeded,
+        })
+    }
+
+    /// Build and run the exercise through every stage it enables. With
+    /// `cancel`, a cancelled verify stops at once with an error.
+    ///
+    /// Binaries are built in a job directory of their own. With `promote`,
+    /// the builds of every stage the verify reached are stored in the
+    /// build cache afterwards; builds of a cancelled verify never are.
+    pub fn verify(
+        &self,
+        compiler: &Compiler,
+        cancel: Option<&Cancel>,
+        promote: bool,
+    ) -> Result<VerifyResult> {
+        let job = compiler.job_dir()?;
+        let bin_path = job.path().join(&self.info.name);
+        let test_bin = job.path().join(format!("{}_test", self.info.name));
+        let san_bin = job.path().join(format!("{}_san", self.info.name));
+
+        let mut reached = Vec::new();
+        let mut tests = Vec::new();
+        let result = self.run_stages(
+            compiler,
+            cancel,
+            [&bin_path, &test_bin, &san_bin],
+            &mut reached,
+            &mut tests,
+        );
+        if promote && result.is_ok() && !cancel.is_some_and(Cancel::is_cancelled) {
+            for (build, binary) in &reached {
+                // The cache only saves time later; a failed store changes
+                // nothing about this verdict.
+                let _ = compiler.promote(build, binary);
             }
+        }
+        result.map(|result| VerifyResult { tests, ..result })
+    }
 
-            let san_result = run_binary(&san_bin)?;
-            if !san_result.success {
-                return Ok(VerifyResult {
-                    success: false,
-                    stage: "sanitizer check",
-                    output: san_result.output,
+    /// The stages of `verify`, recording each build whose stage came up in
+    /// `reached` and the harness's per-test results in `tests`.
+    fn run_stages<'p>(
+        &self,
+        compiler: &Compiler,
+        cancel: Option<&Cancel>,
+        [bin_path, test_bin, san_bin]: [&'p Path; 3],
+        reached: &mut Vec<(CompileResult, &'p Path)>,
+        tests: &mut Vec<TestRecord>,
+    ) -> Result<VerifyResult> {
+        // The three builds are independent, so start the test and sanitizer
+        // compiles right away and only wait for each one when its stage comes
+        // up. Stages are still reported in their usual order.
+        std::thread::scope(|scope| {
+            let test_build = self
+                .info
+                .test
+                .then(|| scope.spawn(|| compiler.compile_with_tests(&self.path, test_bin, cancel)));
+            let san_build = self
+                .info
+                .sanitizers
+                .then(|| {
+                    scope.spawn(|| compiler.compile_with_sanitizers(&self.path, san_bin, cancel))
                 });
+
+            let mut timings = Vec::new();
+            let fail = |stage, output, timings| {
+                Ok(VerifyResult {
+                    success: false,
+                    stage,
+                    output,
+                    timings,
+                    cached: false,
+                    tests: Vec::new(),
+                })
+            };
+
+            // Step 1: Compile
+            let result = compiler.compile(&self.path, bin_path, cancel)?;
+            timings.push(StageTiming::compile("compilation", &result));
+            let failed = (!result.success).then(|| result.output.clone());
+            reached.push((result, bin_path));
+            if let Some(output) = failed {
+                return fail("compilation", output, timings);
             }
-        }
 
-        Ok(VerifyResult {
-            success: true,
-            stage: "complete",
-            output: run_output,
+            // Step 2: Run the binary
+            let run_result = self.run_program(bin_path, cancel, false)?;
+            timings.push(StageTiming::run("execution", &run_result));
+            if run_result.timed_out {
+                return fail("timeout", run_result.output, timings);
+            }
+            if !run_result.success {
+                return fail("execution", run_result.output, timings);
+            }
+            let run_output = run_result.output;
+
+            // Step 3: Run the tests (if enabled)
+            if let Some(build) = test_build {
+                let result = join_build(build)?;
+                timings.push(StageTiming::compile("test compilation", &result));
+                let failed = (!result.success).then(|| result.output.clone());
+                reached.push((result, test_bin));
+                if let Some(output) = failed {
+                    return fail("test compilation", output, timings);
+                }
+
+                let test_result = self.run_program(test_bin, cancel, false)?;
+                timings.push(StageTiming::run("tests", &test_result));
+                let mut report = Report::parse(&test_result.records);
+                let test_output = test_result.output;
+                *tests = std::mem::take(&mut report.tests);
+                if test_result.timed_out {
+                    return fail("timeout", test_output, timings);
+                }
+                if !test_result.success {
+                    return fail("tests", test_output, timings);
+                }
+
+                // Step 3b: Check the benchmarks the tests ran against the
+                // budgets (if any)
+                if !self.info.budgets.is_empty() {
+                    let (within, verdict) = report.check(&self.info.budgets);
+                    if !within {
+                        return fail("performance", format!("{test_output}\n{verdict}"), timings);
+                    }
+                }
+            }
+
+            // Step 4: Run with sanitizers (if enabled)
+            if let Some(build) = san_build {
+                let result = join_build(build)?;
+                timings.push(StageTiming::compile("sanitizer compilation", &result));
+                let failed = (!result.success).then(|| result.output.clone());
+                reached.push((result, san_bin));
+                if let Some(output) = failed {
+                    return fail("sanitizer compilation", output, timings);
+                }
+
+                let san_result = self.run_program(san_bin, cancel, true)?;
+                timings.push(StageTiming::run("sanitizer check", &san_result));
+                if san_result.timed_out {
+                    return fail("timeout", san_result.output, timings);
+                }
+                if !san_result.success {
+                    return fail("sanitizer check", san_result.output, timings);
+                }
+            }
+
+            Ok(VerifyResult {
+                success: true,
+                stage: "complete",
+                output: run_output,
+                timings,
+                cached: false,
+                tests: Vec::new(),
+            })
         })
     }
 }
 
+fn join_build(
+    handle: std::thread::ScopedJoinHandle<'_, Result<CompileResult>>,
+) -> Result<CompileResult> {
+    handle
+        .join()
+        .unwrap_or_else(|_| Err(anyhow::anyhow!("compiler thread panicked")))
+}
+
 struct RunResult {
     success: bool,
     output: String,
+    /// The test harness's report lines, taken out of `output`.
+    records: String,
+    usage: Usage,
+    /// Killed by the wall-clock timeout or the CPU-time limit.
+    timed_out: bool,
 }
 
-fn run_binary(path: &Path) -> Result<RunResult> {
-    let output = Command::new(path).output()?;
+#[cfg(unix)]
+fn exceeded_cpu(status: &std::process::ExitStatus) -> bool {
+    use std::os::unix::process::ExitStatusExt;
+    status.signal() == Some(libc::SIGXCPU)
+}
 
-    let mut combined = String::new();
-    if !output.stdout.is_empty() {
-        combined.push_str(&String::from_utf8_lossy(&output.stdout));
-    }
-    if !output.stderr.is_empty() {
-        if !combined.is_empty() {
-            combined.push('\n');
+#[cfg(not(unix))]
+fn exceeded_cpu(_status: &std::process::ExitStatus) -> bool {
+    false
+}
+
+/// `CLINGS_TEST_TIMEOUT` for a run limited to `stage`: half of it, so a
+/// hanging test times out on its own and the tests after it still get to
+/// report, or less if the environment asks for less.
+fn test_timeout(stage: Duration, requested: Option<String>) -> String {
+    let half = stage.as_secs_f64() / 2.0;
+    let secs = requested
+        .and_then(|value| value.parse::<f64>().ok())
+        .filter(|&secs| secs > 0.0 && secs < half)
+        .unwrap_or(half);
+    format!("{secs:.3}")
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::compiler::CompilerKind;
+    use crate::info_file::InfoFile;
+
+    /// Sanitizer stage time of the UB Lab with ASan's default options and
+    /// with each exercise's profile, and the verdict of both on the broken
+    /// exercises and their solutions, which must agree. Run with
+    /// `cargo test --release -- --ignored --nocapture bench_sanitizer_profile`.
+    #[test]
+    #[ignore]
+    fn bench_sanitizer_profile() {
+        let root = Path::new(env!("CARGO_MANIFEST_DIR"));
+        let info = InfoFile::parse(&root.join("info.toml")).unwrap();
+        let tmp = tempfile::tempdir().unwrap();
+        let compiler = Compiler::new(CompilerKind::Gcc, root).unwrap();
+        let untuned = SanitizerProfile {
+            detect_leaks: Some(true),
+            malloc_context_size: Some(30),
+            print_stacktrace: Some(false),
+        };
+
+        let (mut before, mut after) = (Duration::ZERO, Duration::ZERO);
+        for ei in info.exercises.iter().filter(|ei| ei.dir == "05_ub_lab") {
+            // As `main::load_exercises` merges them.
+            let mut ei = ei.clone();
+            ei.sanitizer = ei.sanitizer.or(info.sanitizer);
+            for dir in ["exercises", "solutions"] {
+                let mut exercise = Exercise::new(ei.clone(), &root.join(dir), &root.join("solutions"));
+                let binary = tmp.path().join(format!("{}_{dir}", ei.name));
+                let build = compiler
+                    .compile_with_sanitizers(&exercise.path, &binary, None)
+                    .unwrap();
+                assert!(build.success, "{}", build.output);
+
+                let mut time = |profile| {
+                    exercise.info.sanitizer = profile;
+                    let mut samples: Vec<RunResult> = (0..15)
+                        .map(|_| exercise.run_program(&binary, None, true).unwrap())
+                        .collect();
+                    samples.sort_by_key(|r| r.usage.wall);
+                    let median = samples.swap_remove(samples.len() / 2);
+                    (median.success, median.usage.wall)
+                };
+                let (tuned_pass, tuned) = time(ei.sanitizer);
+                let (untuned_pass, untuned) = time(untuned);
+                assert_eq!(tuned_pass, untuned_pass, "{} ({dir}) changed verdict", ei.name);
+                println!(
+                    "{:8} {dir:9} pass {tuned_pass:5}: default {untuned:?}, profile {tuned:?}",
+                    ei.name
+                );
+                before += untuned;
+                after += tuned;
+            }
         }
-        combined.push_str(&String::from_utf8_lossy(&output.stderr));
+        println!("UB Lab sanitizer stage total: default {before:?}, profile {after:?}");
     }
 
-    Ok(RunResult {
-        success: output.status.success(),
-        output: combined,
-    })
+    #[test]
+    fn test_timeout_is_within_the_stage_timeout() {
+        let stage = Duration::from_secs(10);
+        assert_eq!(test_timeout(stage, None), "5.000");
+        assert_eq!(test_timeout(stage, Some("1".into())), "1.000");
+        assert_eq!(test_timeout(stage, Some("60".into())), "5.000");
+        assert_eq!(test_timeout(stage, Some("0".into())), "5.000");
+        assert_eq!(test_timeout(Duration::from_secs(1), None), "0.500");
+    }
 }
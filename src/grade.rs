@@ -0,0 +1,171 @@
+use crate::compiler::Compiler;
+use crate::exercise::Exercise;
+use crate::info_file::InfoFile;
+use crate::pool;
+use crate::report::{ExerciseVerdict, WorkspaceRecord};
+use crate::term;
+use std::io::Write;
+use std::path::PathBuf;
+
+struct Workspace {
+    dir: PathBuf,
+    exercises: Vec<Exercise>,
+    /// Why the workspace cannot be graded, if it cannot.
+    error: Option<String>,
+}
+
+/// Verdicts collected so far for one workspace. Only what the report
+/// needs is kept, and only until the workspace is reported.
+struct Progress<'a> {
+    verdicts: Vec<Option<ExerciseVerdict<'a>>>,
+    remaining: usize,
+}
+
+/// Totals for the closing summary of `clings grade`.
+pub struct Summary {
+    pub workspaces: usize,
+    pub workspaces_passed: usize,
+    pub exercises: usize,
+    pub exercises_passed: usize,
+}
+
+/// Grade many student workspaces against the catalogue in `info`.
+///
+/// The catalogue, compiler probe and build cache are shared, and every
+/// (workspace, exercise) pair goes through one job queue of `jobs`
+/// workers. Pairs are queued workspace by workspace, so workspaces finish
+/// (and are reported) progressively instead of all at the end. Builds go
+/// into the build cache, so identical submissions compile once; it is
+/// pruned again when grading ends.
+pub fn grade(
+    info: &InfoFile,
+    dirs: &[PathBuf],
+    compiler: &Compiler,
+    jobs: usize,
+    jsonl: bool,
+) -> Summary {
+    let workspaces: Vec<Workspace> = dirs
+        .iter()
+        .map(|dir| Workspace {
+            dir: dir.clone(),
+            exercises: crate::load_exercises(info, dir),
+            error: (!dir.join("exercises").is_dir())
+                .then(|| format!("{} has no exercises/ directory", dir.display())),
+        })
+        .collect();
+    let mut progress: Vec<Progress> = workspaces
+        .iter()
+        .map(|ws| Progress {
+            verdicts: ws.exercises.iter().map(|_| None).collect(),
+            remaining: if ws.error.is_some() { 0 } else { ws.exercises.len() },
+        })
+        .collect();
+
+    let pairs: Vec<(usize, usize)> = workspaces
+        .iter()
+        .enumerate()
+        .filter(|(_, ws)| ws.error.is_none())
+        .flat_map(|(w, ws)| (0..ws.exercises.len()).map(move |e| (w, e)))
+        .collect();
+
+    let mut summary = Summary {
+        workspaces: workspaces.len(),
+        workspaces_passed: 0,
+        exercises: 0,
+        exercises_passed: 0,
+    };
+    let mut in_order = pool::InOrder::new();
+    let mut finish = |w: usize, progress: &mut Progress| {
+        let record = record(&workspaces[w], std::mem::take(&mut progress.verdicts));
+        summary.exercises += record.total;
+        summary.exercises_passed += record.passed;
+        if record.error.is_none() && record.passed == record.total {
+            summary.workspaces_passed += 1;
+        }
+        if jsonl {
+            let mut stdout = std::io::stdout().lock();
+            let _ = writeln!(stdout, "{}", record.to_json_line());
+            let _ = stdout.flush();
+        } else {
+            for line in in_order.push(w, text_line(&record)) {
+                line();
+            }
+        }
+    };
+
+    // Workspaces with nothing to run are done before the queue starts.
+    for (w, p) in progress.iter_mut().enumerate() {
+        if p.remaining == 0 {
+            finish(w, p);
+        }
+    }
+
+    pool::run(
+        &pairs,
+        jobs,
+        |&(w, e)| {
+            let exercise = &workspaces[w].exercises[e];
+            if !exercise.exists() {
+                return None;
+            }
+            Some(exercise.verify(compiler, None, true))
+        },
+        |idx, outcome| {
+            let (w, e) = pairs[idx];
+            let name = workspaces[w].exercises[e].name();
+            let verdict = match &outcome {
+                Some(Ok(result)) => ExerciseVerdict::new(name, result),
+                Some(Err(_)) => ExerciseVerdict::failed(name, "error"),
+                None => ExerciseVerdict::failed(name, "missing"),
+            };
+            let p = &mut progress[w];
+            p.verdicts[e] = Some(verdict);
+            p.remaining -= 1;
+            if p.remaining == 0 {
+                finish(w, p);
+            }
+        },
+    );
+    compiler.prune_cache();
+
+    summary
+}
+
+fn record<'a>(ws: &'a Workspace, verdicts: Vec<Option<ExerciseVerdict<'a>>>) -> WorkspaceRecord<'a> {
+    let exercises: Vec<ExerciseVerdict> = ws
+        .exercises
+        .iter()
+        .zip(verdicts)
+        .filter(|_| ws.error.is_none())
+        .map(|(exercise, verdict)| {
+            verdict.unwrap_or_else(|| ExerciseVerdict::failed(exercise.name(), "missing"))
+        })
+        .collect();
+    WorkspaceRecord {
+        workspace: ws.dir.display().to_string(),
+        passed: exercises.iter().filter(|v| v.success).count(),
+        total: ws.exercises.len(),
+        error: ws.error.as_deref(),
+        exercises,
+    }
+}
+
+fn text_line(record: &WorkspaceRecord) -> impl FnOnce() {
+    let line = format!("{}  {}/{}", record.workspace, record.passed, record.total);
+    let detail = match (record.error, record.exercises.iter().find(|v| !v.success)) {
+        (Some(error), _) => Some(error.to_string()),
+        (None, Some(first)) => Some(format!("first failure: {} at {}", first.name, first.stage)),
+        (None, None) => None,
+    };
+    let passed = record.error.is_none() && record.passed == record.total;
+    move || {
+        if passed {
+            term::print_success(&line);
+        } else {
+            term::print_error(&line);
+        }
+        if let Some(detail) = detail {
+            term::print_dim(&detail);
+        }
+    }
+}
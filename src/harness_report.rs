@@ -0,0 +1,288 @@
+//! Structured results of the test harness (`include/clings_test.h`).
+//!
+//! The runner passes the harness a pipe of its own, with the descriptor
+//! number in `CLINGS_REPORT`. The harness writes one JSON line to it per
+//! test as the test finishes and one per benchmark after the summary, so
+//! nothing the program prints can pass for a record, and none is lost to
+//! the output limit. The runner keeps the test results and grades the
+//! benchmarks here.
+
+use crate::info_file::Budget;
+use serde::{Deserialize, Serialize};
+
+/// Environment variable with the descriptor of the report pipe.
+pub const REPORT_ENV: &str = "CLINGS_REPORT";
+
+/// Median ns per iteration of the harness's calibration loop on the
+/// machine budgets are written for. Budgets scale by how much slower or
+/// faster the grading machine runs the same loop.
+pub const REFERENCE_CALIBRATION_NS: f64 = 400.0;
+
+#[derive(Debug, Default)]
+pub struct Report {
+    pub calibration_ns: Option<f64>,
+    pub benches: Vec<BenchRecord>,
+    /// In `RUN_TEST` order.
+    pub tests: Vec<TestRecord>,
+    /// Why the benchmark records cannot be trusted: the harness sends one
+    /// calibration and one record per benchmark, all well-formed, so
+    /// anything else was written by someone else.
+    pub rejected: Option<String>,
+}
+
+/// Result of one `RUN_TEST`.
+#[derive(Debug, Clone, PartialEq, Deserialize, Serialize)]
+pub struct TestRecord {
+    pub test: String,
+    pub status: TestStatus,
+    /// Absent for a test that crashed in a forked child.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub duration_ns: Option<f64>,
+    /// Location of the assertion that failed.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub file: Option<String>,
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub line: Option<u32>,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Deserialize, Serialize)]
+#[serde(rename_all = "snake_case")]
+pub enum TestStatus {
+    Passed,
+    Failed,
+    /// Killed by a signal (`isolate_tests` only; in-process, a crash ends
+    /// the whole run).
+    Crashed,
+    TimedOut,
+    /// The child exited before its test body returned (`isolate_tests`
+    /// only), e.g. through a stray `exit()`.
+    Exited,
+}
+
+/// Per-iteration times of one `RUN_BENCH`.
+#[derive(Debug, Deserialize)]
+pub struct BenchRecord {
+    pub bench: String,
+    pub min_ns: f64,
+    pub median_ns: f64,
+    pub p99_ns: f64,
+    /// Allocations per iteration; absent where the harness cannot track
+    /// them.
+    #[serde(default)]
+    pub allocs: Option<u64>,
+}
+
+#[derive(Deserialize)]
+#[serde(untagged)]
+enum Record {
+    Calibration { calibration_ns: f64 },
+    Bench(BenchRecord),
+    Test(TestRecord),
+}
+
+impl Report {
+    /// Read the records of the report pipe. Lines that do not parse and
+    /// repeated calibration or benchmark records are skipped, and reject
+    /// the report for `check`.
+    pub fn parse(records: &str) -> Report {
+        let mut report = Report::default();
+        for line in records.lines() {
+            match serde_json::from_str(line) {
+                Ok(Record::Calibration { calibration_ns }) => {
+                    if report.calibration_ns.is_some() {
+                        report.reject("more than one calibration record".into());
+                    } else {
+                        report.calibration_ns = Some(calibration_ns);
+                    }
+                }
+                Ok(Record::Bench(bench)) => {
+                    if report.benches.iter().any(|b| b.bench == bench.bench) {
+                        report.reject(format!("more than one record for {}", bench.bench));
+                    } else {
+                        report.benches.push(bench);
+                    }
+                }
+                Ok(Record::Test(test)) => report.tests.push(test),
+                Err(_) => report.reject(format!("malformed record {line:?}")),
+            }
+        }
+        report
+    }
+
+    /// Keep the first reason only.
+    fn reject(&mut self, reason: String) {
+        self.rejected.get_or_insert(reason);
+    }
+
+    /// How much slower this machine is than the reference one.
+    fn scale(&self) -> f64 {
+        self.calibration_ns
+            .filter(|ns| ns.is_finite() && *ns > 0.0)
+            .map_or(1.0, |ns| ns / REFERENCE_CALIBRATION_NS)
+    }
+
+    /// Check every budget; returns whether all hold and one line per
+    /// budget.
+    pub fn check(&self, budgets: &[Budget]) -> (bool, String) {
+        if let Some(reason) = &self.rejected {
+            return (false, format!("Benchmark report rejected: {reason}.\n"));
+        }
+        let scale = self.scale();
+        let mut passed = true;
+        let mut text = format!(
+            "Budgets scaled x{scale:.2} for this machine (calibration {}).\n",
+            self.calibration_ns.map_or("missing".into(), format_ns)
+        );
+        for budget in budgets {
+            let Some(b) = self.benches.iter().find(|b| b.bench == budget.bench) else {
+                passed = false;
+                text.push_str(&format!(
+                    "  FAILED  {:<24} did not run (no RUN_BENCH)\n",
+                    budget.bench
+                ));
+                continue;
+            };
+            let mut within = true;
+            let mut checks = Vec::new();
+            if let Some(max_ns) = budget.max_ns {
+                let limit = max_ns * scale;
+                within &= b.median_ns <= limit;
+                checks.push(format!(
+                    "median {} {} {} (min {}, p99 {})",
+                    format_ns(b.median_ns),
+                    if b.median_ns <= limit { "<=" } else { "> " },
+                    format_ns(limit),
+                    format_ns(b.min_ns),
+                    format_ns(b.p99_ns)
+                ));
+            }
+            if let Some(max_allocs) = budget.max_allocs {
+                match b.allocs {
+                    Some(allocs) => {
+                        within &= allocs <= max_allocs;
+                        checks.push(format!(
+                            "{allocs} allocs/op {} {max_allocs}",
+                            if allocs <= max_allocs { "<=" } else { "> " }
+                        ));
+                    }
+                    None => checks.push("allocations not tracked here".into()),
+                }
+            }
+            passed &= within;
+            text.push_str(&format!(
+                "  {:<7} {:<24} {}\n",
+                if within { "ok" } else { "FAILED" },
+                b.bench,
+                checks.join(", ")
+            ));
+        }
+        (passed, text)
+    }
+}
+
+fn format_ns(ns: f64) -> String {
+    if ns < 1e3 {
+        format!("{ns:.1}ns")
+    } else if ns < 1e6 {
+        format!("{:.2}us", ns / 1e3)
+    } else {
+        format!("{:.2}ms", ns / 1e6)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn budget(bench: &str, max_ns: f64) -> Budget {
+        Budget {
+            bench: bench.into(),
+            max_ns: Some(max_ns),
+            max_allocs: None,
+        }
+    }
+
+    const RECORDS: &str = "{\"test\":\"sorted\",\"status\":\"passed\",\"duration_ns\":1200}\n\
+        {\"calibration_ns\":800.000}\n\
+        {\"bench\":\"bench_sort\",\"min_ns\":900.0,\"median_ns\":1000.0,\
+        \"p99_ns\":1500.0,\"iters\":64,\"samples\":30,\"allocs\":2}\n";
+
+    #[test]
+    fn records_are_parsed() {
+        let report = Report::parse(RECORDS);
+        assert_eq!(report.calibration_ns, Some(800.0));
+        assert_eq!(report.benches.len(), 1);
+        assert_eq!(report.benches[0].bench, "bench_sort");
+        assert_eq!(report.benches[0].median_ns, 1000.0);
+        assert_eq!(report.tests.len(), 1);
+        assert_eq!(report.tests[0].status, TestStatus::Passed);
+        assert_eq!(report.tests[0].duration_ns, Some(1200.0));
+    }
+
+    #[test]
+    fn test_records_keep_failure_locations() {
+        let records = "{\"test\":\"a\",\"status\":\"failed\",\"duration_ns\":5,\"file\":\"ex.c\",\"line\":7}\n\
+            {\"test\":\"b\",\"status\":\"crashed\"}\n";
+        let report = Report::parse(records);
+        let [a, b] = &report.tests[..] else {
+            panic!("got {:?}", report.tests);
+        };
+        assert_eq!((a.status, a.file.as_deref(), a.line), (TestStatus::Failed, Some("ex.c"), Some(7)));
+        assert_eq!((b.status, b.duration_ns), (TestStatus::Crashed, None));
+    }
+
+    #[test]
+    fn budgets_scale_with_calibration() {
+        let report = Report::parse(RECORDS);
+        // This machine is half as fast as the reference, so 600ns there
+        // allows 1200ns here.
+        assert!(report.check(&[budget("bench_sort", 600.0)]).0);
+        let (passed, text) = report.check(&[budget("bench_sort", 400.0)]);
+        assert!(!passed);
+        assert!(text.contains("FAILED  bench_sort"), "{text}");
+    }
+
+    #[test]
+    fn allocation_budgets() {
+        let report = Report::parse(RECORDS);
+        let allocs = |max_allocs| Budget {
+            bench: "bench_sort".into(),
+            max_ns: None,
+            max_allocs: Some(max_allocs),
+        };
+        assert!(report.check(&[allocs(2)]).0);
+        assert!(!report.check(&[allocs(1)]).0);
+
+        // A harness that cannot count allocations does not fail the stage.
+        let mut report = Report::parse(RECORDS);
+        report.benches[0].allocs = None;
+        let (passed, text) = report.check(&[allocs(0)]);
+        assert!(passed);
+        assert!(text.contains("not tracked"), "{text}");
+    }
+
+    #[test]
+    fn repeated_or_malformed_records_reject_the_report() {
+        let forged_bench = "{\"bench\":\"bench_sort\",\"min_ns\":1.0,\"median_ns\":1.0,\"p99_ns\":1.0}\n";
+        let forged_calibration = "{\"calibration_ns\":1e9}\n";
+        for records in [
+            format!("{forged_bench}{RECORDS}"),
+            format!("{RECORDS}{forged_calibration}"),
+            format!("{RECORDS}not json\n"),
+        ] {
+            let report = Report::parse(&records);
+            assert_eq!(report.tests.len(), 1);
+            let (passed, text) = report.check(&[budget("bench_sort", 1e9)]);
+            assert!(!passed, "{records}");
+            assert!(text.contains("rejected"), "{text}");
+        }
+    }
+
+    #[test]
+    fn missing_benchmark_fails() {
+        let report = Report::parse(RECORDS);
+        let (passed, text) = report.check(&[budget("bench_other", 1e9)]);
+        assert!(!passed);
+        assert!(text.contains("did not run"), "{text}");
+    }
+}
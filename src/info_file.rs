@@ -17,6 +17,15 @@ pub struct InfoFile {
     #[serde(default)]
     #[allow(dead_code)]
     pub final_message: Option<String>,
+    /// Default `output_limit` for exercises that do not set one.
+    #[serde(default)]
+    pub output_limit: Option<usize>,
+    /// Default `limits` for every exercise.
+    #[serde(default)]
+    pub limits: Limits,
+    /// Default `sanitizer` profile for every exercise.
+    #[serde(default)]
+    pub sanitizer: SanitizerProfile,
     pub exercises: Vec<ExerciseInfo>,
 }
 
@@ -34,6 +43,95 @@ pub struct ExerciseInfo {
     /// Progressive hints array (new format)
     #[serde(default)]
     pub hints: Option<Vec<String>>,
+    /// Bytes of program output kept per run (first and last halves)
+    #[serde(default)]
+    pub output_limit: Option<usize>,
+    /// Resource limits; unset fields come from the top-level `[limits]`
+    #[serde(default)]
+    pub limits: Limits,
+    /// Sanitizer runtime options; unset fields come from `[sanitizer]`
+    #[serde(default)]
+    pub sanitizer: SanitizerProfile,
+    /// Performance budgets, checked in the `performance` stage
+    #[serde(default)]
+    pub budgets: Vec<Budget>,
+    /// Run each test in a forked child, several at once, so a crash fails
+    /// only its own test
+    #[serde(default)]
+    pub isolate_tests: bool,
+}
+
+/// Budget for one benchmark of an exercise's tests (`BENCH` and
+/// `RUN_BENCH` in `clings_test.h`).
+#[derive(Debug, Deserialize, Clone, PartialEq)]
+#[serde(deny_unknown_fields)]
+pub struct Budget {
+    /// Name of the benchmark function
+    pub bench: String,
+    /// Median nanoseconds per iteration on the reference machine; scaled
+    /// by how fast this machine runs the harness's calibration loop
+    #[serde(default)]
+    pub max_ns: Option<f64>,
+    /// Allocations per iteration, where the harness can count them
+    #[serde(default)]
+    pub max_allocs: Option<u64>,
+}
+
+/// Resource limits for each run of an exercise program. Unset fields fall
+/// back to the top-level table, then to the built-in defaults; 0 means
+/// unlimited.
+#[derive(Debug, Deserialize, Clone, Copy, Default, PartialEq)]
+#[serde(deny_unknown_fields)]
+pub struct Limits {
+    /// Wall-clock seconds per run; exceeding it is the `timeout` stage
+    pub timeout_secs: Option<f64>,
+    /// CPU seconds per run (`RLIMIT_CPU`), also reported as `timeout`
+    pub cpu_secs: Option<u64>,
+    /// Address space in MiB (`RLIMIT_AS`); not applied under sanitizers
+    pub memory_mb: Option<u64>,
+    /// Largest file a program may write, in MiB (`RLIMIT_FSIZE`)
+    pub file_size_mb: Option<u64>,
+    /// Processes of the user, counted system-wide (`RLIMIT_NPROC`)
+    pub processes: Option<u64>,
+}
+
+impl Limits {
+    /// Fill the fields not set here from `fallback`.
+    pub fn or(self, fallback: Limits) -> Limits {
+        Limits {
+            timeout_secs: self.timeout_secs.or(fallback.timeout_secs),
+            cpu_secs: self.cpu_secs.or(fallback.cpu_secs),
+            memory_mb: self.memory_mb.or(fallback.memory_mb),
+            file_size_mb: self.file_size_mb.or(fallback.file_size_mb),
+            processes: self.processes.or(fallback.processes),
+        }
+    }
+}
+
+/// Runtime options of the sanitizer stage, passed in `ASAN_OPTIONS` and
+/// `UBSAN_OPTIONS`. Unset fields fall back to the top-level table, then to
+/// the built-in defaults.
+#[derive(Debug, Deserialize, Clone, Copy, Default, PartialEq)]
+#[serde(deny_unknown_fields)]
+pub struct SanitizerProfile {
+    /// Check for leaks at exit. The check takes most of the sanitizer
+    /// stage's time; turn it off where leaks are not what is taught
+    pub detect_leaks: Option<bool>,
+    /// Stack frames recorded per allocation, shown in memory error reports
+    pub malloc_context_size: Option<u32>,
+    /// Print a stack trace with each undefined-behavior report
+    pub print_stacktrace: Option<bool>,
+}
+
+impl SanitizerProfile {
+    /// Fill the fields not set here from `fallback`.
+    pub fn or(self, fallback: SanitizerProfile) -> SanitizerProfile {
+        SanitizerProfile {
+            detect_leaks: self.detect_leaks.or(fallback.detect_leaks),
+            malloc_context_size: self.malloc_context_size.or(fallback.malloc_context_size),
+            print_stacktrace: self.print_stacktrace.or(fallback.print_stacktrace),
+        }
+    }
 }
 
 impl ExerciseInfo {
@@ -64,6 +162,14 @@ impl InfoFile {
                 info.format_version
             );
         }
+        for ex in &info.exercises {
+            if !ex.budgets.is_empty() && !ex.test {
+                anyhow::bail!("Exercise {} has budgets but no tests to run them", ex.name);
+            }
+            if let Some(b) = ex.budgets.iter().find(|b| b.max_ns.is_none() && b.max_allocs.is_none()) {
+                anyhow::bail!("Budget for {} in {} sets neither max_ns nor max_allocs", b.bench, ex.name);
+            }
+        }
         Ok(info)
     }
 
@@ -111,6 +217,77 @@ hint = "legacy hint"
 "#
     }
 
+    #[test]
+    fn exercise_limits_override_global_ones() {
+        let info = InfoFile::parse_str(
+            r#"
+format_version = 1
+[limits]
+timeout_secs = 5.0
+memory_mb = 256
+
+[[exercises]]
+name = "ex1"
+dir = "00_intro"
+limits = { timeout_secs = 30.0, processes = 0 }
+"#,
+        )
+        .unwrap();
+        let limits = info.exercises[0].limits.or(info.limits);
+        assert_eq!(limits.timeout_secs, Some(30.0));
+        assert_eq!(limits.memory_mb, Some(256));
+        assert_eq!(limits.processes, Some(0));
+        assert_eq!(limits.cpu_secs, None);
+    }
+
+    #[test]
+    fn exercise_sanitizer_profile_overrides_global_one() {
+        let info = InfoFile::parse_str(
+            r#"
+format_version = 1
+[sanitizer]
+detect_leaks = true
+malloc_context_size = 5
+
+[[exercises]]
+name = "ex1"
+dir = "05_ub_lab"
+sanitizer = { detect_leaks = false }
+"#,
+        )
+        .unwrap();
+        let profile = info.exercises[0].sanitizer.or(info.sanitizer);
+        assert_eq!(profile.detect_leaks, Some(false));
+        assert_eq!(profile.malloc_context_size, Some(5));
+        assert_eq!(profile.print_stacktrace, None);
+    }
+
+    #[test]
+    fn budgets_need_tests() {
+        let budgets = r#"
+format_version = 1
+[[exercises]]
+name = "sort1"
+dir = "06_perf"
+budgets = [{ bench = "bench_sort", max_ns = 2000.0 }]
+"#;
+        let info = InfoFile::parse_str(budgets).unwrap();
+        assert_eq!(info.exercises[0].budgets[0].bench, "bench_sort");
+        assert_eq!(info.exercises[0].budgets[0].max_ns, Some(2000.0));
+        assert_eq!(info.exercises[0].budgets[0].max_allocs, None);
+
+        let untested = budgets.replace("budgets =", "test = false\nbudgets =");
+        assert!(InfoFile::parse_str(&untested).is_err());
+        let empty = budgets.replace(", max_ns = 2000.0", "");
+        assert!(InfoFile::parse_str(&empty).is_err());
+    }
+
+    #[test]
+    fn unknown_limit_is_an_error() {
+        let toml = "format_version = 1\nexercises = []\n[limits]\ntimeout = 5\n";
+        assert!(InfoFile::parse_str(toml).is_err());
+    }
+
     #[test]
     fn parse_minimal_toml() {
         let info = InfoFile::parse_str(minimal_toml()).unwrap();
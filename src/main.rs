@@ -1,17 +1,32 @@
 mod app_state;
+mod build_dirs;
+mod cache;
 mod compiler;
 mod exercise;
+mod grade;
+mod harness_report;
 mod info_file;
+mod pch;
+mod pool;
+mod probe;
+mod proc;
+mod report;
+mod sandbox;
 mod term;
+mod verdicts;
 mod watch;
 
 use anyhow::{Context, Result};
 use app_state::AppState;
 use clap::{Parser, Subcommand};
 use compiler::{Compiler, CompilerKind};
-use exercise::Exercise;
+use exercise::{Exercise, VerifyResult};
 use info_file::InfoFile;
+use report::ExerciseRecord;
+use std::io::Write;
 use std::path::{Path, PathBuf};
+use std::process::ExitCode;
+use verdicts::{Inputs, VerdictStore};
 
 #[derive(Parser)]
 #[command(name = "clings", version, about = "Small exercises to learn advanced C concepts")]
@@ -22,6 +37,11 @@ struct Cli {
     /// Compiler to use (gcc or clang)
     #[arg(long, global = true, default_value = "gcc")]
     compiler: String,
+
+    /// Run exercise programs in a sandbox (Linux only): no network, a
+    /// read-only filesystem with a private /tmp, and restricted syscalls
+    #[arg(long, global = true)]
+    sandbox: bool,
 }
 
 #[derive(Subcommand)]
@@ -30,6 +50,9 @@ enum Commands {
     Run {
         /// Exercise name
         name: Option<String>,
+        /// Show wall/CPU time and peak memory of every stage
+        #[arg(long)]
+        timings: bool,
     },
     /// Show hint for an exercise (use --level N to reveal up to hint N)
     Hint {
@@ -42,7 +65,35 @@ enum Commands {
     /// List all exercises and their status
     List,
     /// Verify all exercises
-    Verify,
+    Verify {
+        /// Number of exercises to verify in parallel (defaults to the core count)
+        #[arg(short, long, value_parser = clap::value_parser!(u16).range(1..))]
+        jobs: Option<u16>,
+        /// Show per-stage timings for each exercise
+        #[arg(long)]
+        timings: bool,
+        /// Output format: colored text, or one JSON record per exercise
+        /// printed as soon as it finishes
+        #[arg(long, default_value = "text", value_parser = ["text", "jsonl"])]
+        format: String,
+        /// Re-verify every exercise, even those unchanged since they passed
+        #[arg(long)]
+        force: bool,
+    },
+    /// Grade student workspaces (directories with their own exercises/)
+    /// against this project's exercise list
+    Grade {
+        /// Workspace directories to grade
+        #[arg(required = true)]
+        workspaces: Vec<PathBuf>,
+        /// Number of exercises to verify in parallel (defaults to the core count)
+        #[arg(short, long, value_parser = clap::value_parser!(u16).range(1..))]
+        jobs: Option<u16>,
+        /// Output format: colored text, or one JSON record per workspace
+        /// printed as soon as it is graded
+        #[arg(long, default_value = "text", value_parser = ["text", "jsonl"])]
+        format: String,
+    },
     /// Reset progress (start from scratch)
     Reset,
 }
@@ -67,11 +118,17 @@ fn load_exercises(info: &InfoFile, base_dir: &Path) -> Vec<Exercise> {
     let solutions_dir = base_dir.join("solutions");
     info.exercises
         .iter()
-        .map(|ei| Exercise::new(ei.clone(), &exercises_dir, &solutions_dir))
+        .map(|ei| {
+            let mut ei = ei.clone();
+            ei.output_limit = ei.output_limit.or(info.output_limit);
+            ei.limits = ei.limits.or(info.limits);
+            ei.sanitizer = ei.sanitizer.or(info.sanitizer);
+            Exercise::new(ei, &exercises_dir, &solutions_dir)
+        })
         .collect()
 }
 
-fn main() -> Result<()> {
+fn main() -> Result<ExitCode> {
     let cli = Cli::parse();
 
     let base_dir = resolve_base_dir().context(
@@ -86,19 +143,28 @@ fn main() -> Result<()> {
         other => anyhow::bail!("Unknown compiler: {other}. Use 'gcc' or 'clang'."),
     };
 
-    let compiler = Compiler::new(compiler_kind, &base_dir)?;
+    if cli.sandbox {
+        sandbox::probe().context("Cannot sandbox programs on this system")?;
+        sandbox::enable();
+    }
+
+    let mut compiler = Compiler::new(compiler_kind, &base_dir)?;
+    if let Some(Commands::Run { timings: true, .. } | Commands::Verify { timings: true, .. }) =
+        &cli.command
+    {
+        compiler.split_phases();
+    }
     let exercises = load_exercises(&info, &base_dir);
     let build_dir = base_dir.join("target").join("clings");
-    let exercises_dir = base_dir.join("exercises");
     let mut state = AppState::new(exercises, &base_dir)?;
 
     match cli.command {
         None => {
             // Default: watch mode
             let welcome = info.welcome_message.as_deref();
-            watch::run_watch(&mut state, &compiler, &exercises_dir, &build_dir, welcome)?;
+            watch::run_watch(&mut state, &compiler, welcome)?;
         }
-        Some(Commands::Run { name }) => {
+        Some(Commands::Run { name, timings }) => {
             let name = name.unwrap_or_else(|| {
                 state
                     .current_exercise()
@@ -115,7 +181,7 @@ fn main() -> Result<()> {
             term::print_header(&format!("Running: {}", exercise.name()));
             println!();
 
-            let result = exercise.verify(&compiler, &build_dir)?;
+            let result = exercise.verify(&compiler, None, true)?;
             if result.success {
                 term::print_success(&format!("{} passed!", exercise.name()));
                 if !result.output.is_empty() {
@@ -128,7 +194,12 @@ fn main() -> Result<()> {
                     result.stage
                 ));
                 term::print_stage_output(result.stage, &result.output);
-                std::process::exit(1);
+            }
+            if timings {
+                term::print_timings(&result.timings);
+            }
+            if !result.success {
+                return Ok(ExitCode::FAILURE);
             }
         }
         Some(Commands::Hint { name, level }) => {
@@ -204,46 +275,174 @@ fn main() -> Result<()> {
             term::print_success("Progress reset. Starting fresh!");
             println!();
         }
-        Some(Commands::Verify) => {
-            println!();
-            term::print_header("Verifying all exercises...");
-            println!();
+        Some(Commands::Grade {
+            workspaces,
+            jobs,
+            format,
+        }) => {
+            let jsonl = format == "jsonl";
+            if !jsonl {
+                println!();
+                term::print_header(&format!("Grading {} workspaces...", workspaces.len()));
+                println!();
+            }
 
-            let mut all_passed = true;
-            for exercise in &state.exercises {
-                if !exercise.exists() {
-                    term::print_warning(&format!("{}: file not found", exercise.name()));
-                    continue;
+            let jobs = jobs.map_or_else(pool::default_jobs, usize::from);
+            let summary = grade::grade(&info, &workspaces, &compiler, jobs, jsonl);
+            let all_passed = summary.workspaces_passed == summary.workspaces;
+            if !jsonl {
+                println!();
+                let line = format!(
+                    "{}/{} workspaces passed, {}/{} exercises",
+                    summary.workspaces_passed,
+                    summary.workspaces,
+                    summary.exercises_passed,
+                    summary.exercises
+                );
+                if all_passed {
+                    term::print_success(&line);
+                } else {
+                    term::print_error(&line);
                 }
-                match exercise.verify(&compiler, &build_dir) {
-                    Ok(result) => {
-                        if result.success {
-                            term::print_success(exercise.name());
-                        } else {
-                            term::print_error(&format!(
-                                "{} (failed at: {})",
-                                exercise.name(),
-                                result.stage
-                            ));
-                            all_passed = false;
+            }
+            if !all_passed {
+                return Ok(ExitCode::FAILURE);
+            }
+        }
+        Some(Commands::Verify {
+            jobs,
+            timings,
+            format,
+            force,
+        }) => {
+            let jsonl = format == "jsonl";
+            if !jsonl {
+                println!();
+                term::print_header("Verifying all exercises...");
+                println!();
+            }
+
+            // Exercises whose inputs match their last passing verdict are
+            // reported as cached instead of being built and run again.
+            let mut verdicts = VerdictStore::load(&build_dir);
+            let mut inputs: Vec<Option<Inputs>> = state
+                .exercises
+                .iter()
+                .map(|exercise| Inputs::new(&compiler, exercise).ok())
+                .collect();
+            let work: Vec<(&Exercise, bool)> = state
+                .exercises
+                .iter()
+                .zip(&inputs)
+                .map(|(exercise, inputs)| {
+                    let fresh = !force
+                        && inputs
+                            .as_ref()
+                            .is_some_and(|inputs| verdicts.passed(exercise.name(), inputs));
+                    (exercise, fresh)
+                })
+                .collect();
+
+            let jobs = jobs.map_or_else(pool::default_jobs, usize::from);
+            let mut all_passed = true;
+            let mut cached = 0;
+            let mut in_order = pool::InOrder::new();
+            pool::run(
+                &work,
+                jobs,
+                |&(exercise, fresh)| {
+                    if !exercise.exists() {
+                        return None;
+                    }
+                    if fresh {
+                        return Some(Ok(VerifyResult::cached_pass()));
+                    }
+                    Some(exercise.verify(&compiler, None, true))
+                },
+                |idx, outcome| {
+                    let exercise = &state.exercises[idx];
+                    match (&outcome, inputs[idx].take()) {
+                        (Some(Ok(result)), Some(inputs)) => {
+                            cached += usize::from(result.cached);
+                            verdicts.record(exercise.name(), inputs, result);
                         }
+                        _ => verdicts.forget(exercise.name()),
                     }
-                    Err(e) => {
-                        term::print_error(&format!("{}: {e}", exercise.name()));
-                        all_passed = false;
+                    if jsonl {
+                        // Completion order, so consumers see each result immediately.
+                        let error;
+                        let record = match &outcome {
+                            None => ExerciseRecord::unverified(exercise, "missing", "file not found"),
+                            Some(Ok(result)) => {
+                                all_passed &= result.success;
+                                ExerciseRecord::verified(exercise, result)
+                            }
+                            Some(Err(e)) => {
+                                all_passed = false;
+                                error = e.to_string();
+                                ExerciseRecord::unverified(exercise, "error", &error)
+                            }
+                        };
+                        let mut stdout = std::io::stdout().lock();
+                        let _ = writeln!(stdout, "{}", record.to_json_line());
+                        let _ = stdout.flush();
+                        return;
                     }
-                }
-            }
+                    for (exercise, outcome) in in_order.push(idx, (exercise, outcome)) {
+                        match outcome {
+                            None => {
+                                term::print_warning(&format!("{}: file not found", exercise.name()));
+                            }
+                            Some(Ok(result)) => {
+                                if result.cached {
+                                    term::print_success(&format!("{} (cached)", exercise.name()));
+                                } else if result.success {
+                                    term::print_success(exercise.name());
+                                } else {
+                                    term::print_error(&format!(
+                                        "{} (failed at: {})",
+                                        exercise.name(),
+                                        result.stage
+                                    ));
+                                    all_passed = false;
+                                }
+                                if timings && !result.cached {
+                                    term::print_dim(&exercise::compact_timings(&result.timings));
+                                }
+                            }
+                            Some(Err(e)) => {
+                                term::print_error(&format!("{}: {e}", exercise.name()));
+                                all_passed = false;
+                            }
+                        }
+                    }
+                },
+            );
+
+            // The store only saves work; failing to write it is not fatal.
+            let _ = verdicts.save();
 
+            if jsonl {
+                return Ok(if all_passed {
+                    ExitCode::SUCCESS
+                } else {
+                    ExitCode::FAILURE
+                });
+            }
             println!();
             if all_passed {
                 term::print_success("All exercises passed!");
+                if cached > 0 {
+                    term::print_dim(&format!(
+                        "{cached} unchanged since they last passed; use --force to re-verify them."
+                    ));
+                }
             } else {
                 term::print_error("Some exercises failed.");
-                std::process::exit(1);
+                return Ok(ExitCode::FAILURE);
             }
         }
     }
 
-    Ok(())
+    Ok(ExitCode::SUCCESS)
 }
@@ -0,0 +1,217 @@
+use crate::cache::Fingerprint;
+use crate::compiler::CompilerKind;
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::process::{Command, Stdio};
+use std::sync::Mutex;
+
+/// Wrapper header that gets precompiled: the test harness plus the libc
+/// headers nearly every exercise pulls in.
+const WRAPPER_NAME: &str = "clings_pch.h";
+const WRAPPER: &str = "\
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include \"clings_test.h\"
+";
+
+/// Precompiled test-harness headers under `target/clings/pch`, one per
+/// compiler, flag set and `clings_test.h` contents.
+///
+/// The harness is force-included ahead of the exercise; its include guard
+/// turns the exercise's own `#include "clings_test.h"` into a no-op, and
+/// `TEST` stays defined (as the function-like macro), so `#ifndef TEST`
+/// still selects the test build. Only exercises that `fits` are built
+/// this way.
+pub struct PchStore {
+    dir: PathBuf,
+    /// Extra compile flags per key; `None` records a failed build so it is
+    /// not retried on every compile.
+    built: Mutex<HashMap<String, Option<Vec<String>>>>,
+}
+
+/// Whether the wrapper can go ahead of `source` without changing what it
+/// means: the exercise must open (after comments and blank lines) with
+/// `#include <...>` lines, as the wrapper does, and include no local header
+/// among them. A `#define` there, such as
+/// `_POSIX_C_SOURCE`, only takes effect before the first system header, and
+/// a local header may define names the libc headers use; both would be
+/// silently ignored or clash once the wrapper comes first.
+pub fn fits(source: &[u8]) -> bool {
+    let text = String::from_utf8_lossy(source);
+    let mut in_comment = false;
+    let mut includes = 0;
+    for line in text.lines() {
+        let mut rest = line;
+        let mut code = String::new();
+        while !rest.is_empty() {
+            if in_comment {
+                match rest.find("*/") {
+                    Some(end) => {
+                        rest = &rest[end + 2..];
+                        in_comment = false;
+                    }
+                    None => rest = "",
+                }
+            } else if let Some(start) = rest.find("/*") {
+                code.push_str(&rest[..start]);
+                code.push(' ');
+                rest = &rest[start + 2..];
+                in_comment = true;
+            } else {
+                code.push_str(rest);
+                rest = "";
+            }
+        }
+        let code = code.split("//").next().unwrap_or_default().trim();
+        if code.is_empty() {
+            continue;
+        }
+        let Some(directive) = code.strip_prefix('#') else {
+            return includes > 0;
+        };
+        match directive.trim_start().strip_prefix("include") {
+            Some(header) if header.trim_start().starts_with('<') => includes += 1,
+            Some(_) => return false,
+            None => return includes > 0,
+        }
+    }
+    includes > 0
+}
+
+impl PchStore {
+    pub fn new(dir: PathBuf) -> Self {
+        Self {
+            dir,
+            built: Mutex::new(HashMap::new()),
+        }
+    }
+
+    /// Flags that make a compile with `flags` use the precompiled harness,
+    /// building it first if needed. `None` means compile normally.
+    pub fn flags_for(
+        &self,
+        kind: CompilerKind,
+        version: &str,
+        flags: &[String],
+        harness: &[u8],
+    ) -> Option<Vec<String>> {
+        let mut fp = Fingerprint::new();
+        fp.update(version.as_bytes());
+        for flag in flags {
+            fp.update(flag.as_bytes());
+        }
+        fp.update(harness);
+        let key = fp.hex();
+
+        // Holding the lock while building keeps parallel verify workers from
+        // all precompiling the same header at once.
+        let mut built = self.built.lock().unwrap_or_else(|e| e.into_inner());
+        built
+            .entry(key)
+            .or_insert_with_key(|key| self.prepare(kind, flags, key))
+            .clone()
+    }
+
+    /// Delete a precompiled header the compiler refused, so the next
+    /// compile that wants it builds it afresh.
+    pub fn reject(&self, pch_flags: &[String]) {
+        let mut built = self.built.lock().unwrap_or_else(|e| e.into_inner());
+        built.retain(|key, flags| {
+            let refused = flags.as_deref() == Some(pch_flags);
+            if refused {
+                let _ = std::fs::remove_dir_all(self.dir.join(key));
+            }
+            !refused
+        });
+    }
+
+    fn prepare(&self, kind: CompilerKind, flags: &[String], key: &str) -> Option<Vec<String>> {
+        let entry = self.dir.join(key);
+        let wrapper = entry.join(WRAPPER_NAME);
+        let pch = entry.join(pch_file_name(kind));
+        // Build in place (clang records the wrapper's path in the PCH) and
+        // rename only the finished PCH, so other processes never see a
+        // half-written one.
+        if !pch.exists() && !build(kind, flags, &wrapper, &pch) {
+            return None;
+        }
+
+        let flags = match kind {
+            CompilerKind::Gcc => vec!["-include".into(), wrapper.to_str()?.into()],
+            CompilerKind::Clang => vec!["-include-pch".into(), pch.to_str()?.into()],
+        };
+        Some(flags)
+    }
+}
+
+/// Whether a failed compile's `output` is about the precompiled header
+/// itself (clang names the PCH when it refuses one, for example after
+/// its inputs changed on disk) rather than about the exercise.
+pub fn refused(output: &str) -> bool {
+    output.contains(WRAPPER_NAME)
+}
+
+fn pch_file_name(kind: CompilerKind) -> String {
+    match kind {
+        // gcc picks up `<header>.gch` next to a header named by -include.
+        CompilerKind::Gcc => format!("{WRAPPER_NAME}.gch"),
+        CompilerKind::Clang => format!("{WRAPPER_NAME}.pch"),
+    }
+}
+
+fn build(kind: CompilerKind, flags: &[String], wrapper: &Path, pch: &Path) -> bool {
+    let Some(dir) = wrapper.parent() else {
+        return false;
+    };
+    if std::fs::create_dir_all(dir).is_err() || std::fs::write(wrapper, WRAPPER).is_err() {
+        return false;
+    }
+    let tmp = pch.with_extension(format!("tmp.{}", std::process::id()));
+    // Linker options make the driver link the header as a program.
+    let built = Command::new(kind.command_name())
+        .args(flags.iter().filter(|flag| !flag.starts_with("-Wl,")))
+        .args(["-x", "c-header", "-o"])
+        .arg(&tmp)
+        .arg(wrapper)
+        .stdin(Stdio::null())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .status()
+        .map(|s| s.success())
+        .unwrap_or(false);
+    let renamed = built && std::fs::rename(&tmp, pch).is_ok();
+    if !renamed {
+        let _ = std::fs::remove_file(&tmp);
+    }
+    renamed
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn pch_file_names() {
+        assert_eq!(pch_file_name(CompilerKind::Gcc), "clings_pch.h.gch");
+        assert_eq!(pch_file_name(CompilerKind::Clang), "clings_pch.h.pch");
+    }
+
+    #[test]
+    fn wrapper_includes_harness_last() {
+        assert!(WRAPPER.trim_end().ends_with("#include \"clings_test.h\""));
+    }
+
+    #[test]
+    fn wrapper_fits_before_system_includes_only() {
+        assert!(fits(b"// intro\n/* multi\n line */\n#include <stdio.h>\n# include <limits.h>\n\
+            #ifndef TEST\nint main(void) { return 0; }\n#endif\n"));
+        assert!(fits(b"#include <stdio.h> /* for printf */\nint x;\n"));
+
+        assert!(!fits(b"#define _POSIX_C_SOURCE 200809L\n#include <stdio.h>\n"));
+        assert!(!fits(b"#include \"list.h\"\n#include <stdio.h>\n"));
+        assert!(!fits(b"#include <stdio.h>\n#include \"list.h\"\n"));
+        assert!(!fits(b"int main(void) { return 0; }\n"));
+        assert!(!fits(b"/* #include <stdio.h> */\n#define X 1\n"));
+    }
+}
@@ -0,0 +1,117 @@
+use std::collections::BTreeMap;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc;
+
+/// Default worker count: one per available core.
+pub fn default_jobs() -> usize {
+    std::thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+}
+
+/// Run `job` on every item using up to `jobs` worker threads.
+///
+/// Workers claim the next unclaimed index from a shared counter, so an idle
+/// worker always picks up whatever is left and one slow item never holds the
+/// others back. `on_done` runs on the calling thread, in completion order.
+pub fn run<T, R, F, G>(items: &[T], jobs: usize, job: F, mut on_done: G)
+where
+    T: Sync,
+    R: Send,
+    F: Fn(&T) -> R + Sync,
+    G: FnMut(usize, R),
+{
+    let workers = jobs.clamp(1, items.len().max(1));
+    let next = AtomicUsize::new(0);
+    let (tx, rx) = mpsc::channel();
+
+    std::thread::scope(|scope| {
+        for _ in 0..workers {
+            let tx = tx.clone();
+            let next = &next;
+            let job = &job;
+            scope.spawn(move || loop {
+                let idx = next.fetch_add(1, Ordering::Relaxed);
+                let Some(item) = items.get(idx) else {
+                    break;
+                };
+                if tx.send((idx, job(item))).is_err() {
+                    break;
+                }
+            });
+        }
+        drop(tx);
+
+        for (idx, result) in rx {
+            on_done(idx, result);
+        }
+    });
+}
+
+/// Reorders results that arrive out of order so they can be released
+/// in index order.
+pub struct InOrder<R> {
+    next: usize,
+    pending: BTreeMap<usize, R>,
+}
+
+impl<R> InOrder<R> {
+    pub fn new() -> Self {
+        Self {
+            next: 0,
+            pending: BTreeMap::new(),
+        }
+    }
+
+    /// Add the result for `idx` and return every result that is now ready.
+    pub fn push(&mut self, idx: usize, result: R) -> Vec<R> {
+        self.pending.insert(idx, result);
+        let mut ready = Vec::new();
+        while let Some(result) = self.pending.remove(&self.next) {
+            ready.push(result);
+            self.next += 1;
+        }
+        ready
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn run_visits_every_item_once() {
+        let items: Vec<usize> = (0..50).collect();
+        let mut seen = vec![0; items.len()];
+        run(&items, 4, |n| n * 2, |idx, doubled| {
+            assert_eq!(doubled, idx * 2);
+            seen[idx] += 1;
+        });
+        assert!(seen.iter().all(|&n| n == 1));
+    }
+
+    #[test]
+    fn run_with_more_jobs_than_items() {
+        let items = [1, 2];
+        let mut total = 0;
+        run(&items, 16, |n| *n, |_, n| total += n);
+        assert_eq!(total, 3);
+    }
+
+    #[test]
+    fn run_with_no_items() {
+        let items: [u8; 0] = [];
+        let mut calls = 0;
+        run(&items, 4, |_| (), |_, _| calls += 1);
+        assert_eq!(calls, 0);
+    }
+
+    #[test]
+    fn in_order_holds_back_until_gap_filled() {
+        let mut order = InOrder::new();
+        assert!(order.push(1, "b").is_empty());
+        assert!(order.push(2, "c").is_empty());
+        assert_eq!(order.push(0, "a"), vec!["a", "b", "c"]);
+        assert_eq!(order.push(3, "d"), vec!["d"]);
+    }
+}
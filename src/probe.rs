@@ -0,0 +1,196 @@
+use crate::compiler::CompilerKind;
+use anyhow::{Context, Result};
+use serde::{Deserialize, Serialize};
+use std::path::{Path, PathBuf};
+use std::process::{Command, Stdio};
+
+/// Flags added to every compile when the compiler accepts them.
+pub const OPTIONAL_FLAGS: &[&str] = &["-fno-diagnostics-show-fix-it-hints"];
+
+/// Sanitizer flags used for the sanitizer stage.
+pub const SANITIZE_FLAG: &str = "-fsanitize=address,undefined";
+
+/// Linker flag that routes the allocator through the test harness's
+/// allocation tracker (`CLINGS_TRACK_ALLOCS` in `clings_test.h`).
+pub const WRAP_ALLOC_FLAG: &str = "-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free";
+
+/// What a compiler on this machine can do, probed once and persisted
+/// under `target/clings/` so later launches skip the extra processes.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Capabilities {
+    /// Resolved executable path, size and mtime; a mismatch re-probes.
+    pub stamp: String,
+    pub version: String,
+    /// Entries of `OPTIONAL_FLAGS` the compiler accepts.
+    pub flags: Vec<String>,
+    /// Whether a program built with `SANITIZE_FLAG` links.
+    pub sanitizers: bool,
+    /// Whether the linker takes `WRAP_ALLOC_FLAG` (GNU ld, gold, lld; not
+    /// the macOS linker).
+    pub wrap_allocs: bool,
+}
+
+impl Capabilities {
+    /// Load the persisted probe for `kind` if it still matches the installed
+    /// compiler, otherwise probe again and persist the result.
+    pub fn load_or_probe(kind: CompilerKind, build_dir: &Path) -> Result<Self> {
+        let name = kind.command_name();
+        let exe = find_in_path(name)
+            .with_context(|| format!("{name} not found. Please install it."))?;
+        let stamp = executable_stamp(&exe)?;
+        let probe_file = build_dir.join(format!("probe-{name}.toml"));
+
+        if let Some(caps) = Self::load(&probe_file) {
+            if caps.stamp == stamp {
+                return Ok(caps);
+            }
+        }
+
+        let caps = Self::probe(kind, &exe, stamp, build_dir)?;
+        // Persisting is an optimisation; a read-only tree still works.
+        let _ = caps.save(&probe_file);
+        Ok(caps)
+    }
+
+    pub fn supports(&self, flag: &str) -> bool {
+        self.flags.iter().any(|f| f == flag)
+    }
+
+    fn load(path: &Path) -> Option<Self> {
+        let content = std::fs::read_to_string(path).ok()?;
+        toml::from_str(&content).ok()
+    }
+
+    fn save(&self, path: &Path) -> Result<()> {
+        let dir = path.parent().unwrap_or(Path::new("."));
+        std::fs::create_dir_all(dir)?;
+        let tmp = path.with_extension(format!("toml.{}", std::process::id()));
+        std::fs::write(&tmp, toml::to_string(self)?)?;
+        std::fs::rename(&tmp, path)?;
+        Ok(())
+    }
+
+    fn probe(kind: CompilerKind, exe: &Path, stamp: String, build_dir: &Path) -> Result<Self> {
+        let name = kind.command_name();
+        let version = Command::new(exe)
+            .arg("--version")
+            .stderr(Stdio::null())
+            .output()
+            .with_context(|| format!("Failed to run {name}"))?;
+        if !version.status.success() {
+            anyhow::bail!("{name} --version failed");
+        }
+
+        let flags = OPTIONAL_FLAGS
+            .iter()
+            .filter(|flag| accepts_flag(exe, flag))
+            .map(|flag| flag.to_string())
+            .collect();
+
+        Ok(Self {
+            stamp,
+            version: String::from_utf8_lossy(&version.stdout).into_owned(),
+            flags,
+            sanitizers: links_with(exe, SANITIZE_FLAG, build_dir),
+            wrap_allocs: links_with(exe, WRAP_ALLOC_FLAG, build_dir),
+        })
+    }
+}
+
+fn find_in_path(name: &str) -> Option<PathBuf> {
+    let path = std::env::var_os("PATH")?;
+    std::env::split_paths(&path)
+        .map(|dir| dir.join(name))
+        .find(|candidate| candidate.is_file())
+}
+
+fn executable_stamp(exe: &Path) -> Result<String> {
+    let resolved = std::fs::canonicalize(exe).unwrap_or_else(|_| exe.to_path_buf());
+    let meta = std::fs::metadata(&resolved)
+        .with_context(|| format!("Failed to stat {}", resolved.display()))?;
+    let mtime = meta
+        .modified()
+        .ok()
+        .and_then(|t| t.duration_since(std::time::UNIX_EPOCH).ok())
+        .map(|d| d.as_nanos())
+        .unwrap_or(0);
+    Ok(format!("{} {} {mtime}", resolved.display(), meta.len()))
+}
+
+fn accepts_flag(exe: &Path, flag: &str) -> bool {
+    Command::new(exe)
+        .args([flag, "-x", "c", "-E", "-"])
+        .stdin(Stdio::null())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .status()
+        .map(|s| s.success())
+        .unwrap_or(false)
+}
+
+/// Whether a trivial program links with `flag`, which catches compilers
+/// that accept a sanitizer flag but ship no runtime for it, and linkers
+/// without an option.
+fn links_with(exe: &Path, flag: &str, build_dir: &Path) -> bool {
+    if std::fs::create_dir_all(build_dir).is_err() {
+        return false;
+    }
+    let output = build_dir.join(format!(".probe-{}", std::process::id()));
+    let mut child = match Command::new(exe)
+        .args([flag, "-x", "c", "-o"])
+        .arg(&output)
+        .arg("-")
+        .stdin(Stdio::piped())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .spawn()
+    {
+        Ok(child) => child,
+        Err(_) => return false,
+    };
+    if let Some(mut stdin) = child.stdin.take() {
+        use std::io::Write;
+        let _ = stdin.write_all(b"int main(void) { return 0; }\n");
+    }
+    let linked = child.wait().map(|s| s.success()).unwrap_or(false);
+    let _ = std::fs::remove_file(&output);
+    linked
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sample() -> Capabilities {
+        Capabilities {
+            stamp: "/usr/bin/gcc-13 1000 42".into(),
+            version: "gcc (GCC) 13.2.0\n".into(),
+            flags: vec!["-fno-diagnostics-show-fix-it-hints".into()],
+            sanitizers: true,
+            wrap_allocs: true,
+        }
+    }
+
+    #[test]
+    fn supports_only_recorded_flags() {
+        let caps = sample();
+        assert!(caps.supports("-fno-diagnostics-show-fix-it-hints"));
+        assert!(!caps.supports("-pipe"));
+    }
+
+    #[test]
+    fn save_and_load_round_trip() {
+        let tmp = tempfile::tempdir().unwrap();
+        let path = tmp.path().join("nested").join("probe-gcc.toml");
+        sample().save(&path).unwrap();
+        assert_eq!(Capabilities::load(&path), Some(sample()));
+    }
+
+    #[test]
+    fn load_rejects_garbage() {
+        let tmp = tempfile::tempdir().unwrap();
+        let path = tmp.path().join("probe-gcc.toml");
+        std::fs::write(&path, "not = [valid").unwrap();
+        assert_eq!(Capabilities::load(&path), None);
+    }
+}
@@ -0,0 +1,862 @@
+use std::collections::VecDeque;
+use std::io::{self, Read};
+use std::process::{Child, Command, ExitStatus, Stdio};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Arc, Mutex};
+use std::time::{Duration, Instant};
+
+/// Resources used by one child process (and the children it reaped).
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct Usage {
+    pub wall: Duration,
+    pub user: Duration,
+    pub sys: Duration,
+    /// Peak resident set size in KiB; 0 when the platform cannot tell.
+    pub max_rss_kib: u64,
+}
+
+impl Usage {
+    /// Combine two runs that make up one stage, e.g. a retried compile.
+    pub fn add(self, other: Usage) -> Usage {
+        Usage {
+            wall: self.wall + other.wall,
+            user: self.user + other.user,
+            sys: self.sys + other.sys,
+            max_rss_kib: self.max_rss_kib.max(other.max_rss_kib),
+        }
+    }
+}
+
+/// Cancels a build: kills the processes started under it and makes later
+/// `run` and `wait` calls fail with `ErrorKind::Interrupted`.
+///
+/// Each child runs in its own process group, so killing it also kills
+/// whatever it started (`cc1`, `as`, `ld`, or a test program's children).
+#[derive(Clone, Default)]
+pub struct Cancel(Arc<CancelState>);
+
+#[derive(Default)]
+struct CancelState {
+    cancelled: AtomicBool,
+    /// Children started under this token that are not yet reaped.
+    pids: Mutex<Vec<u32>>,
+}
+
+impl Cancel {
+    pub fn cancel(&self) {
+        self.0.cancelled.store(true, Ordering::SeqCst);
+        let pids = self.0.pids.lock().unwrap_or_else(|e| e.into_inner());
+        for &pid in pids.iter() {
+            kill_group(pid);
+        }
+    }
+
+    pub fn is_cancelled(&self) -> bool {
+        self.0.cancelled.load(Ordering::SeqCst)
+    }
+
+    fn check(&self) -> io::Result<()> {
+        if self.is_cancelled() {
+            Err(io::Error::new(io::ErrorKind::Interrupted, "build cancelled"))
+        } else {
+            Ok(())
+        }
+    }
+
+    fn register(&self, pid: u32) {
+        self.0.pids.lock().unwrap_or_else(|e| e.into_inner()).push(pid);
+        // A cancel that raced the spawn has not seen this pid yet.
+        if self.is_cancelled() {
+            kill_group(pid);
+        }
+    }
+
+    fn unregister(&self, pid: u32) {
+        self.0.pids.lock().unwrap_or_else(|e| e.into_inner()).retain(|&p| p != pid);
+    }
+}
+
+/// Put the child of `cmd` in its own process group, so `Cancel` can kill
+/// the whole tree. Only cancellable runs do this: a child outside the
+/// terminal's foreground group would not see Ctrl-C.
+pub fn isolate(cmd: &mut Command) -> &mut Command {
+    #[cfg(unix)]
+    {
+        use std::os::unix::process::CommandExt;
+        cmd.process_group(0);
+    }
+    cmd
+}
+
+#[cfg(unix)]
+fn kill_group(pid: u32) {
+    // SAFETY: plain syscall. The pid is an unreaped child, so it (and its
+    // group id) cannot have been reused.
+    unsafe {
+        libc::kill(-(pid as libc::pid_t), libc::SIGKILL);
+    }
+}
+
+#[cfg(not(unix))]
+fn kill_group(_pid: u32) {}
+
+/// Run the calling thread at the lowest priority: nice 19 and, on Linux,
+/// `SCHED_IDLE`. Threads and processes it starts afterwards inherit this,
+/// so it covers every compiler and program a build runs. Best effort: it
+/// is a no-op where the priority of a single thread cannot be lowered.
+pub fn lower_thread_priority() {
+    #[cfg(target_os = "linux")]
+    // SAFETY: plain syscalls on the calling thread; `param` outlives the call.
+    unsafe {
+        let tid = libc::gettid();
+        libc::setpriority(libc::PRIO_PROCESS, tid as libc::id_t, 19);
+        let param = libc::sched_param { sched_priority: 0 };
+        libc::sched_setscheduler(0, libc::SCHED_IDLE, &param);
+    }
+}
+
+pub struct ProcOutput {
+    pub status: ExitStatus,
+    pub stdout: Vec<u8>,
+    pub stderr: Vec<u8>,
+    pub usage: Usage,
+}
+
+/// Run `cmd` to completion, capturing stdout and stderr and measuring the
+/// child's resource usage.
+pub fn run(cmd: &mut Command, cancel: Option<&Cancel>) -> io::Result<ProcOutput> {
+    if let Some(cancel) = cancel {
+        cancel.check()?;
+        isolate(cmd);
+    }
+    let started = Instant::now();
+    let child = cmd
+        .stdin(Stdio::null())
+        .stdout(Stdio::piped())
+        .stderr(Stdio::piped())
+        .spawn()?;
+    wait(child, started, cancel)
+}
+
+/// Collect the output of an already spawned `child` and reap it.
+/// `started` is when the child was spawned, for the wall-clock time.
+/// With `cancel`, the child must have been spawned through `isolate`.
+pub fn wait(child: Child, started: Instant, cancel: Option<&Cancel>) -> io::Result<ProcOutput> {
+    let supervised = supervise(child, started, cancel, None, |child| {
+        let stdout = child.stdout.take();
+        let stderr = child.stderr.take();
+        // Drain both pipes at once so a child filling one of them never blocks.
+        let stderr_reader = std::thread::spawn(move || read_all(stderr));
+        let stdout = read_all(stdout)?;
+        let stderr = stderr_reader
+            .join()
+            .unwrap_or_else(|_| Err(io::Error::other("stderr reader panicked")))?;
+        Ok((stdout, stderr))
+    })?;
+    let (stdout, stderr) = supervised.output;
+    Ok(ProcOutput {
+        status: supervised.status,
+        stdout,
+        stderr,
+        usage: supervised.usage,
+    })
+}
+
+/// Limits for one run of an exercise program. `None` means unlimited.
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct RunLimits {
+    /// Wall-clock time before the program and its children are killed.
+    pub timeout: Option<Duration>,
+    /// `RLIMIT_CPU`: seconds of CPU time, then `SIGXCPU`.
+    pub cpu_secs: Option<u64>,
+    /// `RLIMIT_AS`: bytes of address space.
+    pub address_space: Option<u64>,
+    /// `RLIMIT_FSIZE`: largest file the program may write, then `SIGXFSZ`.
+    pub file_size: Option<u64>,
+    /// `RLIMIT_NPROC`: processes of the user, counted system-wide.
+    pub processes: Option<u64>,
+    /// Run the program in the `sandbox`.
+    pub sandbox: bool,
+}
+
+/// How a `run_captured` program ended.
+pub struct RunOutcome {
+    pub status: ExitStatus,
+    pub usage: Usage,
+    /// Killed for exceeding `RunLimits::timeout`.
+    pub timed_out: bool,
+}
+
+/// Run `cmd` to completion under `limits`, with stdout and stderr on one
+/// pipe so `capture` receives them in the order they were written. Memory
+/// use is bounded by the capture's cap however much the program prints.
+/// A capture with a `report_pipe` also gets the program's records.
+pub fn run_captured(
+    cmd: &mut Command,
+    cancel: Option<&Cancel>,
+    limits: &RunLimits,
+    capture: &Capture,
+) -> io::Result<RunOutcome> {
+    if let Some(cancel) = cancel {
+        cancel.check()?;
+    }
+    if cancel.is_some() || limits.timeout.is_some() {
+        isolate(cmd);
+    }
+    apply_limits(cmd, limits);
+    let report = match capture.report_env() {
+        Some(env) => Some(pass_pipe(cmd, env)?),
+        None => None,
+    };
+    if limits.sandbox {
+        crate::sandbox::confine(cmd)?;
+    }
+    let (mut reader, writer) = io::pipe()?;
+    let started = Instant::now();
+    let spawned = cmd
+        .stdin(Stdio::null())
+        .stdout(writer.try_clone()?)
+        .stderr(writer)
+        .spawn();
+    // `cmd` keeps its stdio until it is dropped; release the write ends so
+    // the readers see end-of-file when the program exits.
+    cmd.stdout(Stdio::null()).stderr(Stdio::null());
+    let mut report = report.map(|(reader, writer)| {
+        drop(writer);
+        reader
+    });
+    let child = spawned?;
+
+    let supervised = supervise(child, started, cancel, limits.timeout, |_| {
+        std::thread::scope(|scope| {
+            let records = report
+                .as_mut()
+                .map(|reader| scope.spawn(move || pump(reader, |bytes| capture.push_record(bytes))));
+            let output = pump(&mut reader, |bytes| capture.push(bytes));
+            let records = records.map_or(Ok(()), |reader| {
+                reader
+                    .join()
+                    .unwrap_or_else(|_| Err(io::Error::other("report reader panicked")))
+            });
+            output.and(records)
+        })
+    })?;
+    Ok(RunOutcome {
+        status: supervised.status,
+        usage: supervised.usage,
+        timed_out: supervised.timed_out,
+    })
+}
+
+/// Read `reader` to end-of-file into `sink`.
+fn pump(reader: &mut impl Read, mut sink: impl FnMut(&[u8])) -> io::Result<()> {
+    let mut buf = [0; 8192];
+    loop {
+        match reader.read(&mut buf) {
+            Ok(0) => return Ok(()),
+            Ok(n) => sink(&buf[..n]),
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+}
+
+/// A pipe whose write end the program inherits, with its descriptor
+/// number in the environment variable `env`. Register before the
+/// `sandbox`, which forks the program off in its own hook.
+#[cfg(unix)]
+fn pass_pipe(cmd: &mut Command, env: &str) -> io::Result<(io::PipeReader, io::PipeWriter)> {
+    use std::os::fd::AsRawFd;
+    use std::os::unix::process::CommandExt;
+
+    let (reader, writer) = io::pipe()?;
+    let fd = writer.as_raw_fd();
+    cmd.env(env, fd.to_string());
+    // SAFETY: fcntl is async-signal-safe, and `fd` stays open in clings
+    // until the spawn returns.
+    unsafe {
+        cmd.pre_exec(move || {
+            let flags = libc::fcntl(fd, libc::F_GETFD);
+            if flags < 0 || libc::fcntl(fd, libc::F_SETFD, flags & !libc::FD_CLOEXEC) < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(())
+        });
+    }
+    Ok((reader, writer))
+}
+
+#[cfg(not(unix))]
+fn pass_pipe(_cmd: &mut Command, _env: &str) -> io::Result<(io::PipeReader, io::PipeWriter)> {
+    // Nothing to pass: the program never learns of the pipe, and the
+    // capture gets no records.
+    io::pipe()
+}
+
+#[cfg(unix)]
+fn apply_limits(cmd: &mut Command, limits: &RunLimits) {
+    use std::os::unix::process::CommandExt;
+
+    let rlimits = [
+        (libc::RLIMIT_CPU, limits.cpu_secs),
+        (libc::RLIMIT_AS, limits.address_space),
+        (libc::RLIMIT_FSIZE, limits.file_size),
+        (libc::RLIMIT_NPROC, limits.processes),
+    ];
+    #[cfg(target_os = "linux")]
+    let die_with_parent = limits.timeout.is_some();
+    if rlimits.iter().all(|(_, value)| value.is_none()) && limits.timeout.is_none() {
+        return;
+    }
+    // SAFETY: the hook only makes async-signal-safe syscalls on plain data
+    // it owns, as required between fork and exec.
+    unsafe {
+        cmd.pre_exec(move || {
+            for (resource, value) in rlimits {
+                if let Some(value) = value {
+                    // At the hard CPU limit the kernel sends SIGKILL, which
+                    // looks like any other kill; a second of slack lets the
+                    // SIGXCPU of the soft limit end the program first.
+                    let slack = if resource == libc::RLIMIT_CPU { 1 } else { 0 };
+                    lower_rlimit(resource, value, slack)?;
+                }
+            }
+            // Outside the terminal's process group Ctrl-C no longer reaches
+            // the program, so have it killed when clings exits instead.
+            #[cfg(target_os = "linux")]
+            if die_with_parent {
+                libc::prctl(libc::PR_SET_PDEATHSIG, libc::SIGKILL);
+            }
+            Ok(())
+        });
+    }
+}
+
+#[cfg(not(unix))]
+fn apply_limits(_cmd: &mut Command, _limits: &RunLimits) {}
+
+#[cfg(all(target_os = "linux", target_env = "gnu"))]
+type Resource = libc::__rlimit_resource_t;
+#[cfg(all(unix, not(all(target_os = "linux", target_env = "gnu"))))]
+type Resource = libc::c_int;
+
+/// Set the soft limit of `resource` to `value` and the hard limit `slack`
+/// above it, both capped at the current hard limit (raising it needs
+/// privileges).
+#[cfg(unix)]
+fn lower_rlimit(resource: Resource, value: u64, slack: u64) -> io::Result<()> {
+    // SAFETY: `rlimit` is plain old data filled in by getrlimit.
+    let mut current: libc::rlimit = unsafe { std::mem::zeroed() };
+    if unsafe { libc::getrlimit(resource, &mut current) } != 0 {
+        return Err(io::Error::last_os_error());
+    }
+    let limit = libc::rlimit {
+        rlim_cur: (value as libc::rlim_t).min(current.rlim_max),
+        rlim_max: (value.saturating_add(slack) as libc::rlim_t).min(current.rlim_max),
+    };
+    // SAFETY: `limit` is a valid rlimit for the duration of the call.
+    if unsafe { libc::setrlimit(resource, &limit) } != 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(())
+}
+
+struct Supervised<T> {
+    output: T,
+    status: ExitStatus,
+    usage: Usage,
+    timed_out: bool,
+}
+
+/// Read `child`'s output with `drain`, then reap it and measure its usage.
+/// The child is registered with `cancel`, and killed after `timeout`, for
+/// as long as it can be signalled.
+fn supervise<T>(
+    mut child: Child,
+    started: Instant,
+    cancel: Option<&Cancel>,
+    timeout: Option<Duration>,
+    drain: impl FnOnce(&mut Child) -> io::Result<T>,
+) -> io::Result<Supervised<T>> {
+    let pid = child.id();
+    if let Some(cancel) = cancel {
+        cancel.register(pid);
+    }
+    drop(child.stdin.take());
+
+    let timed_out = AtomicBool::new(false);
+    let (stop, stopped) = mpsc::channel::<()>();
+    let output = std::thread::scope(|scope| {
+        if let Some(timeout) = timeout {
+            let timed_out = &timed_out;
+            scope.spawn(move || {
+                if let Err(mpsc::RecvTimeoutError::Timeout) = stopped.recv_timeout(timeout) {
+                    timed_out.store(true, Ordering::SeqCst);
+                    kill_group(pid);
+                }
+            });
+        }
+        let output = drain(&mut child);
+        if output.is_ok() && (cancel.is_some() || timeout.is_some()) {
+            // Leave the zombie in place until nothing can signal the pid
+            // any more, so a recycled pid is never killed.
+            wait_exit(&child)?;
+        }
+        drop(stop);
+        output
+    });
+    if let Some(cancel) = cancel {
+        cancel.unregister(pid);
+    }
+    let output = output?;
+    let (status, mut usage) = reap(&mut child)?;
+    usage.wall = started.elapsed();
+    if let Some(cancel) = cancel {
+        // A killed child's output is meaningless, report the cancel instead.
+        cancel.check()?;
+    }
+    Ok(Supervised {
+        output,
+        status,
+        usage,
+        timed_out: timed_out.into_inner(),
+    })
+}
+
+/// Bounded program output: the first and the last `cap / 2` bytes are
+/// kept, anything in between is counted and dropped. Clones share the
+/// buffer, so the output can be read while the program is still running.
+///
+/// With `report_pipe`, the program also gets a pipe of its own for
+/// records, which are kept apart from the output and never truncated
+/// with it.
+#[derive(Clone)]
+pub struct Capture(Arc<Mutex<Ring>>);
+
+struct Ring {
+    cap: usize,
+    head: Vec<u8>,
+    tail: VecDeque<u8>,
+    /// Bytes received in total.
+    total: u64,
+    records: Option<Records>,
+}
+
+/// Lines from the report pipe, bounded in size and number.
+struct Records {
+    /// Environment variable that tells the program the pipe's descriptor.
+    env: &'static str,
+    /// The current line so far.
+    line: Vec<u8>,
+    /// The current line outgrew `RECORD_LINE_MAX`.
+    overlong: bool,
+    kept: Vec<u8>,
+    dropped: usize,
+}
+
+/// Longest record line and most bytes of records in all that are kept.
+const RECORD_LINE_MAX: usize = 64 * 1024;
+const RECORDS_MAX: usize = 1 << 20;
+
+impl Capture {
+    pub fn new(cap: usize) -> Self {
+        Self(Arc::new(Mutex::new(Ring {
+            cap,
+            head: Vec::new(),
+            tail: VecDeque::new(),
+            total: 0,
+            records: None,
+        })))
+    }
+
+    /// Give the program a pipe for records, with its descriptor number in
+    /// the environment variable `env`; `records` returns what arrived.
+    /// Beyond a line of 64 KiB or 1 MiB of them in all, records are
+    /// dropped and counted.
+    pub fn report_pipe(self, env: &'static str) -> Self {
+        self.0.lock().unwrap_or_else(|e| e.into_inner()).records = Some(Records {
+            env,
+            line: Vec::new(),
+            overlong: false,
+            kept: Vec::new(),
+            dropped: 0,
+        });
+        self
+    }
+
+    fn report_env(&self) -> Option<&'static str> {
+        let ring = self.0.lock().unwrap_or_else(|e| e.into_inner());
+        ring.records.as_ref().map(|records| records.env)
+    }
+
+    fn push(&self, bytes: &[u8]) {
+        self.0.lock().unwrap_or_else(|e| e.into_inner()).keep(bytes);
+    }
+
+    fn push_record(&self, mut bytes: &[u8]) {
+        let mut ring = self.0.lock().unwrap_or_else(|e| e.into_inner());
+        let Some(records) = ring.records.as_mut() else {
+            return;
+        };
+        while !bytes.is_empty() {
+            let line_end = bytes.iter().position(|&b| b == b'\n').map_or(bytes.len(), |i| i + 1);
+            let part = &bytes[..line_end];
+            if records.line.len() + part.len() > RECORD_LINE_MAX {
+                records.overlong = true;
+            }
+            if !records.overlong {
+                records.line.extend_from_slice(part);
+            }
+            if part.ends_with(b"\n") {
+                records.end_line();
+            }
+            bytes = &bytes[line_end..];
+        }
+    }
+
+    /// Everything kept so far, with a marker where bytes were dropped.
+    pub fn text(&self) -> String {
+        let ring = self.0.lock().unwrap_or_else(|e| e.into_inner());
+        let kept = (ring.head.len() + ring.tail.len()) as u64;
+        let mut text = String::from_utf8_lossy(&ring.head).into_owned();
+        if ring.total > kept {
+            text.push_str(&format!("\n[... {} bytes of output omitted ...]\n", ring.total - kept));
+        }
+        let (a, b) = ring.tail.as_slices();
+        text.push_str(&String::from_utf8_lossy(&[a, b].concat()));
+        text
+    }
+
+    /// The records received so far, and how many more were dropped.
+    pub fn records(&self) -> (String, usize) {
+        let ring = self.0.lock().unwrap_or_else(|e| e.into_inner());
+        let Some(records) = &ring.records else {
+            return (String::new(), 0);
+        };
+        let mut text = String::from_utf8_lossy(&records.kept).into_owned();
+        let mut dropped = records.dropped;
+        // A last line without its newline.
+        if !records.line.is_empty() || records.overlong {
+            if records.overlong || records.kept.len() + records.line.len() > RECORDS_MAX {
+                dropped += 1;
+            } else {
+                text.push_str(&String::from_utf8_lossy(&records.line));
+                text.push('\n');
+            }
+        }
+        (text, dropped)
+    }
+}
+
+impl Ring {
+    fn keep(&mut self, mut bytes: &[u8]) {
+        self.total += bytes.len() as u64;
+        let head_cap = self.cap / 2;
+        let tail_cap = self.cap - head_cap;
+        let room = head_cap - self.head.len();
+        if room > 0 {
+            let n = room.min(bytes.len());
+            self.head.extend_from_slice(&bytes[..n]);
+            bytes = &bytes[n..];
+        }
+        if bytes.len() > tail_cap {
+            bytes = &bytes[bytes.len() - tail_cap..];
+        }
+        let overflow = (self.tail.len() + bytes.len()).saturating_sub(tail_cap);
+        self.tail.drain(..overflow);
+        self.tail.extend(bytes);
+    }
+}
+
+impl Records {
+    fn end_line(&mut self) {
+        if self.overlong || self.kept.len() + self.line.len() > RECORDS_MAX {
+            self.dropped += 1;
+        } else {
+            self.kept.extend_from_slice(&self.line);
+        }
+        self.line.clear();
+        self.overlong = false;
+    }
+}
+
+fn read_all(pipe: Option<impl Read>) -> io::Result<Vec<u8>> {
+    let mut buf = Vec::new();
+    if let Some(mut pipe) = pipe {
+        pipe.read_to_end(&mut buf)?;
+    }
+    Ok(buf)
+}
+
+#[cfg(unix)]
+fn wait_exit(child: &Child) -> io::Result<()> {
+    loop {
+        // SAFETY: `siginfo_t` is plain old data, and `child` is unreaped.
+        let mut info: libc::siginfo_t = unsafe { std::mem::zeroed() };
+        let rc = unsafe {
+            libc::waitid(
+                libc::P_PID,
+                child.id() as libc::id_t,
+                &mut info,
+                libc::WEXITED | libc::WNOWAIT,
+            )
+        };
+        if rc == 0 {
+            return Ok(());
+        }
+        let err = io::Error::last_os_error();
+        if err.kind() != io::ErrorKind::Interrupted {
+            return Err(err);
+        }
+    }
+}
+
+#[cfg(not(unix))]
+fn wait_exit(_child: &Child) -> io::Result<()> {
+    Ok(())
+}
+
+#[cfg(unix)]
+fn reap(child: &mut Child) -> io::Result<(ExitStatus, Usage)> {
+    use std::os::unix::process::ExitStatusExt;
+
+    let pid = child.id() as libc::pid_t;
+    let mut status: libc::c_int = 0;
+    // SAFETY: `rusage` is plain old data; wait4 fills it in on success.
+    let mut rusage: libc::rusage = unsafe { std::mem::zeroed() };
+    loop {
+        // SAFETY: `pid` is our unreaped child, the pointers are valid for
+        // the duration of the call.
+        let rc = unsafe { libc::wait4(pid, &mut status, 0, &mut rusage) };
+        if rc == pid {
+            break;
+        }
+        let err = io::Error::last_os_error();
+        if err.kind() != io::ErrorKind::Interrupted {
+            return Err(err);
+        }
+    }
+    let usage = Usage {
+        wall: Duration::ZERO,
+        user: timeval(rusage.ru_utime),
+        sys: timeval(rusage.ru_stime),
+        max_rss_kib: max_rss_kib(rusage.ru_maxrss),
+    };
+    Ok((ExitStatus::from_raw(status), usage))
+}
+
+#[cfg(not(unix))]
+fn reap(child: &mut Child) -> io::Result<(ExitStatus, Usage)> {
+    Ok((child.wait()?, Usage::default()))
+}
+
+#[cfg(unix)]
+fn timeval(tv: libc::timeval) -> Duration {
+    Duration::from_secs(tv.tv_sec as u64) + Duration::from_micros(tv.tv_usec as u64)
+}
+
+#[cfg(unix)]
+fn max_rss_kib(raw: libc::c_long) -> u64 {
+    // macOS reports bytes, Linux and the BSDs report KiB.
+    if cfg!(target_os = "macos") {
+        raw as u64 / 1024
+    } else {
+        raw as u64
+    }
+}
+
+#[cfg(all(test, unix))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn captures_output_and_status() {
+        let out = run(Command::new("sh").args(["-c", "echo out; echo err >&2; exit 3"]), None)
+            .unwrap();
+        assert_eq!(out.stdout, b"out\n");
+        assert_eq!(out.stderr, b"err\n");
+        assert_eq!(out.status.code(), Some(3));
+    }
+
+    #[test]
+    fn measures_usage() {
+        let out = run(
+            Command::new("sh").args(["-c", "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done"]),
+            None,
+        )
+        .unwrap();
+        assert!(out.status.success());
+        assert!(out.usage.wall > Duration::ZERO);
+        assert!(out.usage.user + out.usage.sys > Duration::ZERO);
+        assert!(out.usage.max_rss_kib > 0);
+    }
+
+    #[test]
+    fn cancel_kills_the_process_tree() {
+        let cancel = Cancel::default();
+        let canceller = {
+            let cancel = cancel.clone();
+            std::thread::spawn(move || {
+                std::thread::sleep(Duration::from_millis(100));
+                cancel.cancel();
+            })
+        };
+        let started = Instant::now();
+        // The grandchild holds stdout open; it must die too for run to return.
+        let err = run(Command::new("sh").args(["-c", "sleep 30 & sleep 30"]), Some(&cancel))
+            .err()
+            .expect("a cancelled run fails");
+        canceller.join().unwrap();
+        assert_eq!(err.kind(), io::ErrorKind::Interrupted);
+        assert!(started.elapsed() < Duration::from_secs(10));
+
+        let err = run(&mut Command::new("true"), Some(&cancel)).err().unwrap();
+        assert_eq!(err.kind(), io::ErrorKind::Interrupted);
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn children_inherit_idle_priority() {
+        let out = std::thread::spawn(|| {
+            lower_thread_priority();
+            run(Command::new("sh").args(["-c", "cut -d' ' -f19 /proc/self/stat"]), None).unwrap()
+        })
+        .join()
+        .unwrap();
+        assert_eq!(String::from_utf8_lossy(&out.stdout).trim(), "19");
+    }
+
+    #[test]
+    fn capture_interleaves_streams() {
+        let capture = Capture::new(1024);
+        let out = run_captured(
+            Command::new("sh").args(["-c", "echo one; echo two >&2; echo three"]),
+            None,
+            &RunLimits::default(),
+            &capture,
+        )
+        .unwrap();
+        assert!(out.status.success());
+        assert_eq!(capture.text(), "one\ntwo\nthree\n");
+    }
+
+    #[test]
+    fn capture_keeps_head_and_tail_of_endless_output() {
+        let capture = Capture::new(64);
+        let out = run_captured(
+            Command::new("sh").args(["-c", "echo start; yes | head -c 1000000; echo; echo end"]),
+            None,
+            &RunLimits::default(),
+            &capture,
+        )
+        .unwrap();
+        assert!(out.status.success());
+        let text = capture.text();
+        assert!(text.starts_with("start\n"), "{text}");
+        assert!(text.ends_with("\nend\n"), "{text}");
+        assert!(text.contains("bytes of output omitted"), "{text}");
+        assert!(text.len() < 200);
+    }
+
+    #[test]
+    fn timeout_kills_the_process_tree() {
+        let limits = RunLimits {
+            timeout: Some(Duration::from_millis(200)),
+            ..RunLimits::default()
+        };
+        let capture = Capture::new(1024);
+        let started = Instant::now();
+        let out = run_captured(
+            Command::new("sh").args(["-c", "echo hi; sleep 30 & sleep 30"]),
+            None,
+            &limits,
+            &capture,
+        )
+        .unwrap();
+        assert!(out.timed_out);
+        assert!(!out.status.success());
+        assert!(started.elapsed() < Duration::from_secs(10));
+        assert_eq!(capture.text(), "hi\n");
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn rlimits_apply_to_the_program() {
+        let limits = RunLimits {
+            cpu_secs: Some(7),
+            file_size: Some(4096),
+            ..RunLimits::default()
+        };
+        let capture = Capture::new(1024);
+        let out = run_captured(
+            Command::new("sh").args(["-c", "ulimit -t; ulimit -Ht; ulimit -f"]),
+            None,
+            &limits,
+            &capture,
+        )
+        .unwrap();
+        assert!(out.status.success());
+        assert!(!out.timed_out);
+        // `ulimit -f` counts 512-byte blocks.
+        assert_eq!(capture.text(), "7\n8\n8\n");
+    }
+
+    #[test]
+    fn capture_ring_keeps_latest_bytes() {
+        let capture = Capture::new(6);
+        for chunk in [&b"abcd"[..], b"ef", b"ghij", b"k"] {
+            capture.push(chunk);
+        }
+        assert_eq!(capture.text(), "abc\n[... 5 bytes of output omitted ...]\nijk");
+    }
+
+    #[test]
+    fn capture_keeps_records_apart_from_the_output() {
+        let capture = Capture::new(8).report_pipe("TEST_REPORT_FD");
+        let out = run_captured(
+            Command::new("sh").args([
+                "-c",
+                "echo '{\"a\":1}' >&$TEST_REPORT_FD; echo '{\"forged\":1}'; \
+                 yes | head -c 1000; echo '{\"b\":2}' >&$TEST_REPORT_FD",
+            ]),
+            None,
+            &RunLimits::default(),
+            &capture,
+        )
+        .unwrap();
+        assert!(out.status.success());
+        assert_eq!(capture.records(), ("{\"a\":1}\n{\"b\":2}\n".into(), 0));
+        let text = capture.text();
+        assert!(text.starts_with("{\"fo"), "{text}");
+        assert!(text.contains("bytes of output omitted"), "{text}");
+    }
+
+    #[test]
+    fn capture_bounds_records() {
+        let capture = Capture::new(8).report_pipe("TEST_REPORT_FD");
+        for chunk in [&b"{\"one\""[..], b"}\n{"] {
+            capture.push_record(chunk);
+        }
+        capture.push_record(&vec![b'z'; RECORD_LINE_MAX]);
+        capture.push_record(b"\n{\"two\"}");
+        assert_eq!(capture.records(), ("{\"one\"}\n{\"two\"}\n".into(), 1));
+        assert_eq!(capture.text(), "");
+    }
+
+    #[test]
+    fn add_sums_times_and_keeps_peak() {
+        let a = Usage {
+            wall: Duration::from_millis(5),
+            user: Duration::from_millis(3),
+            sys: Duration::from_millis(1),
+            max_rss_kib: 100,
+        };
+        let b = Usage {
+            max_rss_kib: 300,
+            ..a
+        };
+        let sum = a.add(b);
+        assert_eq!(sum.wall, Duration::from_millis(10));
+        assert_eq!(sum.max_rss_kib, 300);
+    }
+}
@@ -0,0 +1,249 @@
+use crate::exercise::{Exercise, StageTiming, VerifyResult};
+use crate::harness_report::TestRecord;
+use serde::Serialize;
+
+/// Stage output beyond this many bytes is cut from JSON records.
+pub const MAX_OUTPUT_BYTES: usize = 4096;
+
+/// One line of `clings verify --format jsonl`.
+#[derive(Debug, Serialize)]
+pub struct ExerciseRecord<'a> {
+    pub name: &'a str,
+    pub dir: &'a str,
+    pub success: bool,
+    /// Failing stage, `complete`, `missing` or `error`.
+    pub stage: &'a str,
+    pub duration_ms: f64,
+    /// Passed earlier with the same inputs and was not re-run.
+    pub cached: bool,
+    pub stages: Vec<StageRecord>,
+    /// Per-test results of the tests stage, in `RUN_TEST` order.
+    #[serde(skip_serializing_if = "<[_]>::is_empty")]
+    pub tests: &'a [TestRecord],
+    pub output: &'a str,
+    pub output_truncated: bool,
+}
+
+#[derive(Debug, Serialize)]
+pub struct StageRecord {
+    pub stage: &'static str,
+    pub cached: bool,
+    pub wall_ms: f64,
+    pub user_ms: f64,
+    pub sys_ms: f64,
+    pub max_rss_kib: u64,
+    /// Wall time of each phase of a compile stage, with `--timings`.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub phases: Option<PhaseRecord>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct PhaseRecord {
+    pub preprocess_ms: f64,
+    pub compile_ms: f64,
+    pub link_ms: f64,
+}
+
+impl From<&StageTiming> for StageRecord {
+    fn from(t: &StageTiming) -> Self {
+        Self {
+            stage: t.stage,
+            cached: t.cached,
+            wall_ms: millis(t.usage.wall),
+            user_ms: millis(t.usage.user),
+            sys_ms: millis(t.usage.sys),
+            max_rss_kib: t.usage.max_rss_kib,
+            phases: t.phases.as_ref().map(|p| PhaseRecord {
+                preprocess_ms: millis(p.preprocess.wall),
+                compile_ms: millis(p.compile.wall),
+                link_ms: millis(p.link.wall),
+            }),
+        }
+    }
+}
+
+impl<'a> ExerciseRecord<'a> {
+    pub fn verified(exercise: &'a Exercise, result: &'a VerifyResult) -> Self {
+        let (output, output_truncated) = truncate(&result.output, MAX_OUTPUT_BYTES);
+        Self {
+            name: exercise.name(),
+            dir: &exercise.info.dir,
+            success: result.success,
+            stage: result.stage,
+            duration_ms: millis(result.timings.iter().map(|t| t.usage.wall).sum()),
+            cached: result.cached,
+            stages: result.timings.iter().map(StageRecord::from).collect(),
+            tests: &result.tests,
+            output,
+            output_truncated,
+        }
+    }
+
+    /// A record for an exercise that did not produce a `VerifyResult`.
+    pub fn unverified(exercise: &'a Exercise, stage: &'a str, message: &'a str) -> Self {
+        let (output, output_truncated) = truncate(message, MAX_OUTPUT_BYTES);
+        Self {
+            name: exercise.name(),
+            dir: &exercise.info.dir,
+            success: false,
+            stage,
+            duration_ms: 0.0,
+            cached: false,
+            stages: Vec::new(),
+            tests: &[],
+            output,
+            output_truncated,
+        }
+    }
+
+    pub fn to_json_line(&self) -> String {
+        serde_json::to_string(self).expect("records always serialize")
+    }
+}
+
+/// One line of `clings grade --format jsonl`: a workspace and the verdict
+/// of every exercise in it.
+#[derive(Debug, Serialize)]
+pub struct WorkspaceRecord<'a> {
+    pub workspace: String,
+    pub passed: usize,
+    pub total: usize,
+    /// Set when the workspace could not be graded at all.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub error: Option<&'a str>,
+    pub exercises: Vec<ExerciseVerdict<'a>>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct ExerciseVerdict<'a> {
+    pub name: &'a str,
+    pub success: bool,
+    pub stage: &'a str,
+    pub duration_ms: f64,
+}
+
+impl<'a> ExerciseVerdict<'a> {
+    pub fn new(name: &'a str, result: &VerifyResult) -> Self {
+        Self {
+            name,
+            success: result.success,
+            stage: result.stage,
+            duration_ms: millis(result.timings.iter().map(|t| t.usage.wall).sum()),
+        }
+    }
+
+    /// An exercise that produced no `VerifyResult` (`missing` or `error`).
+    pub fn failed(name: &'a str, stage: &'a str) -> Self {
+        Self {
+            name,
+            success: false,
+            stage,
+            duration_ms: 0.0,
+        }
+    }
+}
+
+impl WorkspaceRecord<'_> {
+    pub fn to_json_line(&self) -> String {
+        serde_json::to_string(self).expect("records always serialize")
+    }
+}
+
+/// Milliseconds with microsecond precision.
+fn millis(d: std::time::Duration) -> f64 {
+    d.as_micros() as f64 / 1000.0
+}
+
+/// Cut `s` to at most `max` bytes on a char boundary.
+fn truncate(s: &str, max: usize) -> (&str, bool) {
+    if s.len() <= max {
+        return (s, false);
+    }
+    let mut end = max;
+    while !s.is_char_boundary(end) {
+        end -= 1;
+    }
+    (&s[..end], true)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::harness_report::TestStatus;
+    use crate::info_file::ExerciseInfo;
+    use crate::proc::Usage;
+    use std::path::Path;
+    use std::time::Duration;
+
+    fn exercise() -> Exercise {
+        let info = ExerciseInfo {
+            name: "ex1".into(),
+            dir: "00_intro".into(),
+            test: true,
+            sanitizers: false,
+            hint: None,
+            hints: None,
+            output_limit: None,
+            limits: Default::default(),
+            sanitizer: Default::default(),
+            budgets: Vec::new(),
+            isolate_tests: false,
+        };
+        Exercise::new(info, Path::new("/tmp/ex"), Path::new("/tmp/sol"))
+    }
+
+    #[test]
+    fn truncate_respects_char_boundaries() {
+        assert_eq!(truncate("héllo", 2), ("h", true));
+        assert_eq!(truncate("abc", 3), ("abc", false));
+    }
+
+    #[test]
+    fn verified_record_is_one_json_line() {
+        let ex = exercise();
+        let result = VerifyResult {
+            success: false,
+            stage: "tests",
+            output: "line1\nline2 \"quoted\"".into(),
+            timings: vec![StageTiming {
+                stage: "compilation",
+                usage: Usage {
+                    wall: Duration::from_millis(40),
+                    ..Usage::default()
+                },
+                cached: false,
+                phases: None,
+            }],
+            cached: false,
+            tests: vec![TestRecord {
+                test: "test_sum".into(),
+                status: TestStatus::Failed,
+                duration_ns: Some(900.0),
+                file: Some("ex1.c".into()),
+                line: Some(12),
+            }],
+        };
+        let line = ExerciseRecord::verified(&ex, &result).to_json_line();
+        assert!(!line.contains('\n'));
+
+        let value: serde_json::Value = serde_json::from_str(&line).unwrap();
+        assert_eq!(value["name"], "ex1");
+        assert_eq!(value["dir"], "00_intro");
+        assert_eq!(value["stage"], "tests");
+        assert_eq!(value["success"], false);
+        assert_eq!(value["duration_ms"], 40.0);
+        assert_eq!(value["stages"][0]["stage"], "compilation");
+        assert_eq!(value["tests"][0]["status"], "failed");
+        assert_eq!(value["tests"][0]["line"], 12);
+        assert_eq!(value["output"], "line1\nline2 \"quoted\"");
+    }
+
+    #[test]
+    fn long_output_is_truncated() {
+        let ex = exercise();
+        let long = "x".repeat(MAX_OUTPUT_BYTES + 10);
+        let record = ExerciseRecord::unverified(&ex, "error", &long);
+        assert_eq!(record.output.len(), MAX_OUTPUT_BYTES);
+        assert!(record.output_truncated);
+    }
+}
@@ -0,0 +1,804 @@
+//! Optional sandbox for exercise programs (`--sandbox`, Linux only).
+//!
+//! The program gets its own user, mount, network and pid namespaces. The
+//! root filesystem is read-only and nodev except for `/dev/null`,
+//! `/dev/zero` and `/dev/urandom`, `/tmp` is a private tmpfs, there is no
+//! network but loopback, and a seccomp allowlist turns every other system
+//! call (mounts, namespaces, sockets, BPF, ...) into `EPERM`.
+//!
+//! Everything happens in a `pre_exec` hook of the spawned child, which
+//! stays outside the namespaces as a small supervisor:
+//!
+//! ```text
+//! clings ── supervisor ─┬─ init     (pid 1, reaps orphans)
+//!                       └─ program  (pid 2, seccomp filter, execs)
+//! ```
+//!
+//! The supervisor exits with the program's status, so timeouts, rlimits,
+//! `Cancel` and the usage figures work exactly as without the sandbox.
+//! The program is not pid 1 itself because pid 1 ignores the default
+//! action of signals it sends to itself, and `abort()` would not end it
+//! with `SIGABRT`.
+
+use std::io;
+use std::process::Command;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// Run every exercise program from now on inside the sandbox.
+pub fn enable() {
+    ENABLED.store(true, Ordering::Relaxed);
+}
+
+pub fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Check that this system can sandbox programs, by running `true` in the
+/// sandbox. Fails without unprivileged user namespaces, for example.
+pub fn probe() -> io::Result<()> {
+    let mut cmd = Command::new("true");
+    confine(&mut cmd)?;
+    let status = cmd
+        .stdin(std::process::Stdio::null())
+        .stdout(std::process::Stdio::null())
+        .stderr(std::process::Stdio::null())
+        .status()?;
+    if status.success() {
+        Ok(())
+    } else {
+        Err(io::Error::other(format!("sandboxed `true` failed: {status}")))
+    }
+}
+
+/// Make `cmd` run its program in the sandbox. Call after any other
+/// `pre_exec` hook, such as the rlimits of `proc::run_captured`, and
+/// after setting its arguments and environment: the hook execs the
+/// program itself, with what `cmd` has at this point.
+#[cfg(target_os = "linux")]
+pub fn confine(cmd: &mut Command) -> io::Result<()> {
+    use std::os::unix::process::CommandExt;
+
+    let setup = linux::Setup::new(cmd)?;
+    // SAFETY: the hook only makes raw system calls on data prepared here,
+    // never allocating or taking locks, as required between fork and exec.
+    unsafe {
+        cmd.pre_exec(move || setup.enter());
+    }
+    Ok(())
+}
+
+#[cfg(not(target_os = "linux"))]
+pub fn confine(_cmd: &mut Command) -> io::Result<()> {
+    Err(io::Error::new(
+        io::ErrorKind::Unsupported,
+        "the sandbox needs Linux namespaces",
+    ))
+}
+
+#[cfg(target_os = "linux")]
+mod linux {
+    use std::collections::BTreeMap;
+    use std::ffi::{CStr, CString, OsStr, OsString};
+    use std::io;
+    use std::os::unix::ffi::OsStrExt;
+    use std::os::unix::fs::PermissionsExt;
+    use std::path::PathBuf;
+    use std::process::Command;
+    use std::ptr;
+
+    const MOVE_MOUNT_F_EMPTY_PATH: libc::c_uint = 0x4;
+
+    /// The only device nodes the program can open.
+    const DEVICES: [&CStr; 3] = [c"/dev/null", c"/dev/zero", c"/dev/urandom"];
+
+    /// Who the program runs as when clings itself runs as root: mapping
+    /// root into the namespace would leave it the owner of every file.
+    const NOBODY: libc::uid_t = 65534;
+
+    /// Everything the hook needs, allocated before the fork.
+    pub struct Setup {
+        uid_map: Vec<u8>,
+        gid_map: Vec<u8>,
+        drop_root: bool,
+        filter: Option<Vec<libc::sock_filter>>,
+        /// The program is opened before anything changes and exec'd by
+        /// descriptor: run as nobody, it may not be able to reach its own
+        /// path (build directories are private to the user clings runs
+        /// as), and the private `/tmp` hides programs below it.
+        program: CString,
+        argv: CStrings,
+        envp: CStrings,
+    }
+
+    /// A null-terminated array of C strings, for execveat.
+    struct CStrings {
+        _strings: Vec<CString>,
+        ptrs: Vec<*const libc::c_char>,
+    }
+
+    // SAFETY: the pointers point into `_strings`, which the struct owns
+    // and never changes.
+    unsafe impl Send for CStrings {}
+    unsafe impl Sync for CStrings {}
+
+    impl CStrings {
+        fn new(items: impl IntoIterator<Item = Vec<u8>>) -> io::Result<Self> {
+            let strings = items
+                .into_iter()
+                .map(|item| CString::new(item).map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e)))
+                .collect::<io::Result<Vec<_>>>()?;
+            let ptrs = strings.iter().map(|s| s.as_ptr()).chain([ptr::null()]).collect();
+            Ok(Self { _strings: strings, ptrs })
+        }
+    }
+
+    impl Setup {
+        pub fn new(cmd: &Command) -> io::Result<Self> {
+            // SAFETY: plain syscalls without arguments.
+            let (uid, gid) = unsafe { (libc::getuid(), libc::getgid()) };
+            let drop_root = uid == 0;
+            let (uid, gid) = if drop_root { (NOBODY, NOBODY) } else { (uid, gid) };
+
+            let mut env: BTreeMap<OsString, OsString> = std::env::vars_os().collect();
+            for (key, value) in cmd.get_envs() {
+                match value {
+                    Some(value) => env.insert(key.to_owned(), value.to_owned()),
+                    None => env.remove(key),
+                };
+            }
+            let program = resolve(cmd.get_program(), env.get(OsStr::new("PATH")));
+            let argv = std::iter::once(cmd.get_program())
+                .chain(cmd.get_args())
+                .map(|arg| arg.as_bytes().to_vec());
+            let envp = env.iter().map(|(key, value)| {
+                [key.as_bytes(), b"=", value.as_bytes()].concat()
+            });
+            Ok(Self {
+                uid_map: format!("{uid} {uid} 1").into_bytes(),
+                gid_map: format!("{gid} {gid} 1").into_bytes(),
+                drop_root,
+                filter: super::seccomp::filter(),
+                program: CString::new(program.as_os_str().as_bytes())
+                    .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?,
+                argv: CStrings::new(argv)?,
+                envp: CStrings::new(envp)?,
+            })
+        }
+
+        /// Runs in the forked child. Returns only in the program process,
+        /// which then execs; the supervisor and init never return.
+        pub fn enter(&self) -> io::Result<()> {
+            // SAFETY: raw syscalls on valid, pre-built arguments.
+            unsafe {
+                let exe = libc::open(self.program.as_ptr(), libc::O_PATH | libc::O_CLOEXEC);
+                check(exe as libc::c_long)?;
+                if self.drop_root {
+                    check(libc::syscall(libc::SYS_setgroups, 0, ptr::null::<libc::gid_t>()))?;
+                    check(libc::syscall(libc::SYS_setresgid, NOBODY, NOBODY, NOBODY))?;
+                    check(libc::syscall(libc::SYS_setresuid, NOBODY, NOBODY, NOBODY))?;
+                    // Changing credentials clears both; the id maps below
+                    // can only be written by a dumpable process.
+                    libc::prctl(libc::PR_SET_DUMPABLE, 1);
+                    libc::prctl(libc::PR_SET_PDEATHSIG, libc::SIGKILL);
+                }
+                check(libc::unshare(
+                    libc::CLONE_NEWUSER | libc::CLONE_NEWNS | libc::CLONE_NEWNET | libc::CLONE_NEWPID,
+                ) as libc::c_long)?;
+                write_file(c"/proc/self/setgroups", b"deny")?;
+                write_file(c"/proc/self/uid_map", &self.uid_map)?;
+                write_file(c"/proc/self/gid_map", &self.gid_map)?;
+
+                // Keep our mounts from propagating back to the host.
+                check(mount(None, c"/", None, libc::MS_REC | libc::MS_PRIVATE, None))?;
+                // Detached copies of the allowed devices escape the nodev
+                // below; they go back over the originals afterwards.
+                let mut devices = [-1; DEVICES.len()];
+                for (fd, path) in devices.iter_mut().zip(DEVICES) {
+                    let flags = libc::OPEN_TREE_CLONE | libc::OPEN_TREE_CLOEXEC;
+                    *fd = libc::syscall(libc::SYS_open_tree, libc::AT_FDCWD, path.as_ptr(), flags) as libc::c_int;
+                }
+                let attr = libc::mount_attr {
+                    attr_set: libc::MOUNT_ATTR_RDONLY | libc::MOUNT_ATTR_NODEV,
+                    attr_clr: 0,
+                    propagation: 0,
+                    userns_fd: 0,
+                };
+                check(libc::syscall(
+                    libc::SYS_mount_setattr,
+                    libc::AT_FDCWD,
+                    c"/".as_ptr(),
+                    libc::AT_RECURSIVE,
+                    &attr,
+                    std::mem::size_of::<libc::mount_attr>(),
+                ))?;
+                for (fd, path) in devices.into_iter().zip(DEVICES) {
+                    if fd >= 0 {
+                        check(libc::syscall(
+                            libc::SYS_move_mount,
+                            fd,
+                            c"".as_ptr(),
+                            libc::AT_FDCWD,
+                            path.as_ptr(),
+                            MOVE_MOUNT_F_EMPTY_PATH,
+                        ))?;
+                        libc::close(fd);
+                    }
+                }
+                check(mount(
+                    Some(c"tmpfs"),
+                    c"/tmp",
+                    Some(c"tmpfs"),
+                    libc::MS_NOSUID | libc::MS_NODEV,
+                    Some(c"size=64m,mode=1777"),
+                ))?;
+
+                // The first child in the new pid namespace is its init.
+                let init = fork()?;
+                if init == 0 {
+                    libc::prctl(libc::PR_SET_PDEATHSIG, libc::SIGKILL);
+                    close_all();
+                    loop {
+                        if libc::waitpid(-1, ptr::null_mut(), 0) < 0 {
+                            libc::pause();
+                        }
+                    }
+                }
+                let program = match fork() {
+                    Ok(pid) => pid,
+                    Err(e) => {
+                        libc::kill(init, libc::SIGKILL);
+                        return Err(e);
+                    }
+                };
+                if program == 0 {
+                    return self.enter_program(exe);
+                }
+
+                // Supervisor: hold no pipes (the parent's spawn waits for
+                // its exec-error pipe to close), then mirror the program.
+                close_all();
+                let mut status = 0;
+                while libc::waitpid(program, &mut status, 0) < 0 {}
+                // Killing init ends anything the program left running.
+                libc::kill(init, libc::SIGKILL);
+                while libc::waitpid(init, ptr::null_mut(), 0) < 0 {}
+                exit_like(status)
+            }
+        }
+
+        /// Set up the program process and exec the program; returns only
+        /// if that fails.
+        unsafe fn enter_program(&self, exe: libc::c_int) -> io::Result<()> {
+            // A /proc of the new pid namespace; best effort, as it is
+            // refused where the host's /proc is partly masked.
+            mount(
+                Some(c"proc"),
+                c"/proc",
+                Some(c"proc"),
+                libc::MS_NOSUID | libc::MS_NODEV | libc::MS_NOEXEC,
+                None,
+            );
+            if let Some(filter) = &self.filter {
+                check(libc::prctl(libc::PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) as libc::c_long)?;
+                let prog = libc::sock_fprog {
+                    len: filter.len() as libc::c_ushort,
+                    filter: filter.as_ptr() as *mut libc::sock_filter,
+                };
+                check(libc::prctl(libc::PR_SET_SECCOMP, libc::SECCOMP_MODE_FILTER, &prog) as libc::c_long)?;
+            }
+            libc::syscall(
+                libc::SYS_execveat,
+                exe,
+                c"".as_ptr(),
+                self.argv.ptrs.as_ptr(),
+                self.envp.ptrs.as_ptr(),
+                libc::AT_EMPTY_PATH,
+            );
+            Err(io::Error::last_os_error())
+        }
+    }
+
+    /// Where the program is, looked up in `path` like execvp does when
+    /// it names no directory.
+    fn resolve(program: &OsStr, path: Option<&OsString>) -> PathBuf {
+        if program.as_bytes().contains(&b'/') {
+            return program.into();
+        }
+        let path = path.map_or(OsStr::new("/usr/bin:/bin"), |p| p.as_os_str());
+        std::env::split_paths(path)
+            .map(|dir| dir.join(program))
+            .find(|candidate| {
+                std::fs::metadata(candidate).is_ok_and(|m| m.is_file() && m.permissions().mode() & 0o111 != 0)
+            })
+            .unwrap_or_else(|| program.into())
+    }
+
+    fn check(rc: libc::c_long) -> io::Result<()> {
+        if rc < 0 {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(())
+        }
+    }
+
+    unsafe fn mount(
+        source: Option<&CStr>,
+        target: &CStr,
+        fstype: Option<&CStr>,
+        flags: libc::c_ulong,
+        data: Option<&CStr>,
+    ) -> libc::c_long {
+        let ptr_of = |s: Option<&CStr>| s.map_or(ptr::null(), |s| s.as_ptr());
+        libc::mount(
+            ptr_of(source),
+            target.as_ptr(),
+            ptr_of(fstype),
+            flags,
+            ptr_of(data).cast(),
+        ) as libc::c_long
+    }
+
+    unsafe fn write_file(path: &CStr, content: &[u8]) -> io::Result<()> {
+        let fd = libc::open(path.as_ptr(), libc::O_WRONLY | libc::O_CLOEXEC);
+        check(fd as libc::c_long)?;
+        let written = libc::write(fd, content.as_ptr().cast(), content.len());
+        let err = io::Error::last_os_error();
+        libc::close(fd);
+        if written == content.len() as isize {
+            Ok(())
+        } else {
+            Err(err)
+        }
+    }
+
+    /// fork(2) as a raw system call. The libc wrapper takes the malloc
+    /// locks, which another thread of clings may have held when the
+    /// supervisor was forked.
+    unsafe fn fork() -> io::Result<libc::pid_t> {
+        let pid = libc::syscall(libc::SYS_clone, libc::SIGCHLD, 0, 0, 0, 0);
+        check(pid)?;
+        Ok(pid as libc::pid_t)
+    }
+
+    unsafe fn close_all() {
+        if libc::syscall(libc::SYS_close_range, 0, u32::MAX, 0) != 0 {
+            for fd in 0..1024 {
+                libc::close(fd);
+            }
+        }
+    }
+
+    /// End the supervisor the way the program ended.
+    unsafe fn exit_like(status: libc::c_int) -> ! {
+        if libc::WIFSIGNALED(status) {
+            let signal = libc::WTERMSIG(status);
+            // The program already dumped core if it was going to.
+            let no_core = libc::rlimit {
+                rlim_cur: 0,
+                rlim_max: 0,
+            };
+            libc::setrlimit(libc::RLIMIT_CORE, &no_core);
+            libc::signal(signal, libc::SIG_DFL);
+            libc::kill(libc::getpid(), signal);
+            libc::_exit(128 + signal);
+        }
+        libc::_exit(libc::WEXITSTATUS(status))
+    }
+}
+
+/// The seccomp allowlist: what C programs, the dynamic loader and the
+/// sanitizer runtimes need. LeakSanitizer stops the program's threads
+/// with `ptrace`, which the pid namespace confines to the program itself.
+#[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64")))]
+mod seccomp {
+    #[cfg(target_arch = "x86_64")]
+    const AUDIT_ARCH: u32 = 0xC000_003E;
+    #[cfg(target_arch = "aarch64")]
+    const AUDIT_ARCH: u32 = 0xC000_00B7;
+
+    /// Offsets into `struct seccomp_data`.
+    const NR: u32 = 0;
+    const ARCH: u32 = 4;
+    /// Low half of the first argument (both targets are little-endian).
+    const ARG0: u32 = 16;
+
+    /// Namespace flags a `clone` may not pass.
+    const NEW_NAMESPACES: libc::c_int = libc::CLONE_NEWNS
+        | libc::CLONE_NEWUTS
+        | libc::CLONE_NEWIPC
+        | libc::CLONE_NEWUSER
+        | libc::CLONE_NEWPID
+        | libc::CLONE_NEWNET
+        | libc::CLONE_NEWCGROUP;
+
+    const ALLOWED: &[libc::c_long] = &[
+        // Files and descriptors.
+        libc::SYS_read,
+        libc::SYS_write,
+        libc::SYS_readv,
+        libc::SYS_writev,
+        libc::SYS_pread64,
+        libc::SYS_pwrite64,
+        libc::SYS_preadv,
+        libc::SYS_pwritev,
+        libc::SYS_preadv2,
+        libc::SYS_pwritev2,
+        libc::SYS_openat,
+        libc::SYS_openat2,
+        libc::SYS_close,
+        libc::SYS_close_range,
+        libc::SYS_lseek,
+        libc::SYS_fstat,
+        libc::SYS_newfstatat,
+        libc::SYS_statx,
+        libc::SYS_statfs,
+        libc::SYS_fstatfs,
+        libc::SYS_faccessat,
+        libc::SYS_faccessat2,
+        libc::SYS_readlinkat,
+        libc::SYS_getdents64,
+        libc::SYS_getcwd,
+        libc::SYS_chdir,
+        libc::SYS_fchdir,
+        libc::SYS_mkdirat,
+        libc::SYS_unlinkat,
+        libc::SYS_renameat,
+        libc::SYS_renameat2,
+        libc::SYS_linkat,
+        libc::SYS_symlinkat,
+        libc::SYS_fchmod,
+        libc::SYS_fchmodat,
+        libc::SYS_ftruncate,
+        libc::SYS_truncate,
+        libc::SYS_fallocate,
+        libc::SYS_fsync,
+        libc::SYS_fdatasync,
+        libc::SYS_flock,
+        libc::SYS_umask,
+        libc::SYS_dup,
+        libc::SYS_dup3,
+        libc::SYS_fcntl,
+        libc::SYS_ioctl,
+        libc::SYS_pipe2,
+        libc::SYS_memfd_create,
+        libc::SYS_ppoll,
+        libc::SYS_pselect6,
+        libc::SYS_epoll_create1,
+        libc::SYS_epoll_ctl,
+        libc::SYS_epoll_pwait,
+        libc::SYS_eventfd2,
+        libc::SYS_timerfd_create,
+        libc::SYS_timerfd_settime,
+        libc::SYS_timerfd_gettime,
+        // Memory.
+        libc::SYS_brk,
+        libc::SYS_mmap,
+        libc::SYS_munmap,
+        libc::SYS_mremap,
+        libc::SYS_mprotect,
+        libc::SYS_madvise,
+        libc::SYS_msync,
+        libc::SYS_mincore,
+        libc::SYS_mlock,
+        libc::SYS_munlock,
+        libc::SYS_membarrier,
+        // Processes and threads.
+        libc::SYS_execve,
+        libc::SYS_execveat,
+        libc::SYS_exit,
+        libc::SYS_exit_group,
+        libc::SYS_wait4,
+        libc::SYS_waitid,
+        libc::SYS_kill,
+        libc::SYS_tkill,
+        libc::SYS_tgkill,
+        libc::SYS_ptrace,
+        libc::SYS_prctl,
+        libc::SYS_personality,
+        libc::SYS_futex,
+        libc::SYS_set_robust_list,
+        libc::SYS_get_robust_list,
+        libc::SYS_set_tid_address,
+        libc::SYS_rseq,
+        libc::SYS_sched_yield,
+        libc::SYS_sched_getaffinity,
+        libc::SYS_sched_setaffinity,
+        libc::SYS_sched_getparam,
+        libc::SYS_sched_getscheduler,
+        libc::SYS_getpid,
+        libc::SYS_getppid,
+        libc::SYS_gettid,
+        libc::SYS_getpgid,
+        libc::SYS_setpgid,
+        libc::SYS_getsid,
+        libc::SYS_setsid,
+        libc::SYS_getuid,
+        libc::SYS_geteuid,
+        libc::SYS_getgid,
+        libc::SYS_getegid,
+        libc::SYS_getresuid,
+        libc::SYS_getresgid,
+        libc::SYS_getgroups,
+        libc::SYS_capget,
+        libc::SYS_prlimit64,
+        libc::SYS_getrusage,
+        // Signals.
+        libc::SYS_rt_sigaction,
+        libc::SYS_rt_sigprocmask,
+        libc::SYS_rt_sigreturn,
+        libc::SYS_rt_sigsuspend,
+        libc::SYS_rt_sigpending,
+        libc::SYS_rt_sigtimedwait,
+        libc::SYS_rt_sigqueueinfo,
+        libc::SYS_sigaltstack,
+        libc::SYS_restart_syscall,
+        libc::SYS_setitimer,
+        libc::SYS_getitimer,
+        // Time and system information.
+        libc::SYS_clock_gettime,
+        libc::SYS_clock_getres,
+        libc::SYS_clock_nanosleep,
+        libc::SYS_nanosleep,
+        libc::SYS_gettimeofday,
+        libc::SYS_times,
+        libc::SYS_uname,
+        libc::SYS_sysinfo,
+        libc::SYS_getrandom,
+        // Legacy calls that only x86-64 has.
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_open,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_creat,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_stat,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_lstat,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_access,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_readlink,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_getdents,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_mkdir,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_rmdir,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_unlink,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_rename,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_link,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_symlink,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_chmod,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_pipe,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_dup2,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_poll,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_select,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_epoll_create,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_epoll_wait,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_fork,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_vfork,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_arch_prctl,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_getpgrp,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_pause,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_alarm,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_time,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_getrlimit,
+        #[cfg(target_arch = "x86_64")]
+        libc::SYS_setrlimit,
+    ];
+
+    fn stmt(code: u32, k: u32) -> libc::sock_filter {
+        jump(code, k, 0, 0)
+    }
+
+    fn jump(code: u32, k: u32, jt: usize, jf: usize) -> libc::sock_filter {
+        libc::sock_filter {
+            code: code as u16,
+            jt: u8::try_from(jt).expect("seccomp jump out of range"),
+            jf: u8::try_from(jf).expect("seccomp jump out of range"),
+            k,
+        }
+    }
+
+    /// The BPF program. Other architectures (x32 calls included) are
+    /// killed outright; `clone3` reports `ENOSYS` so libc falls back to
+    /// `clone`, whose flags can be checked.
+    pub fn filter() -> Option<Vec<libc::sock_filter>> {
+        use libc::{BPF_ABS, BPF_JEQ, BPF_JMP, BPF_JSET, BPF_K, BPF_LD, BPF_RET, BPF_W};
+
+        const LOAD: u32 = BPF_LD | BPF_W | BPF_ABS;
+        const JEQ: u32 = BPF_JMP | BPF_JEQ | BPF_K;
+        const JSET: u32 = BPF_JMP | BPF_JSET | BPF_K;
+        const RET: u32 = BPF_RET | BPF_K;
+
+        // Layout: 8 checks, the allowlist, then deny, allow, no-such-call.
+        let deny = 8 + ALLOWED.len();
+        let (allow, nosys) = (deny + 1, deny + 2);
+        // Relative jump from instruction `from` to `to`.
+        let to = |from: usize, to: usize| to - from - 1;
+
+        let mut prog = vec![
+            stmt(LOAD, ARCH),
+            jump(JEQ, AUDIT_ARCH, 1, 0),
+            stmt(RET, libc::SECCOMP_RET_KILL_PROCESS),
+            stmt(LOAD, NR),
+            jump(JEQ, libc::SYS_clone3 as u32, to(4, nosys), 0),
+            jump(JEQ, libc::SYS_clone as u32, 0, to(5, 8)),
+            stmt(LOAD, ARG0),
+            jump(JSET, NEW_NAMESPACES as u32, to(7, deny), to(7, allow)),
+        ];
+        for (i, &nr) in ALLOWED.iter().enumerate() {
+            prog.push(jump(JEQ, nr as u32, to(8 + i, allow), 0));
+        }
+        prog.push(stmt(RET, libc::SECCOMP_RET_ERRNO | libc::EPERM as u32));
+        prog.push(stmt(RET, libc::SECCOMP_RET_ALLOW));
+        prog.push(stmt(RET, libc::SECCOMP_RET_ERRNO | libc::ENOSYS as u32));
+        Some(prog)
+    }
+}
+
+/// Namespaces only where no syscall table is maintained.
+#[cfg(all(target_os = "linux", not(any(target_arch = "x86_64", target_arch = "aarch64"))))]
+mod seccomp {
+    pub fn filter() -> Option<Vec<libc::sock_filter>> {
+        None
+    }
+}
+
+#[cfg(all(test, target_os = "linux"))]
+mod tests {
+    use super::*;
+    use crate::proc::{self, Capture, RunLimits};
+
+    /// Namespaces may be unavailable (containers, hardened kernels).
+    fn available() -> bool {
+        match probe() {
+            Ok(()) => true,
+            Err(e) => {
+                eprintln!("sandbox unavailable, skipping: {e}");
+                false
+            }
+        }
+    }
+
+    fn run_sandboxed(script: &str) -> (std::process::ExitStatus, String) {
+        let capture = Capture::new(4096);
+        let limits = RunLimits {
+            sandbox: true,
+            ..RunLimits::default()
+        };
+        let out = proc::run_captured(Command::new("sh").args(["-c", script]), None, &limits, &capture)
+            .unwrap();
+        (out.status, capture.text())
+    }
+
+    #[test]
+    fn program_is_confined() {
+        if !available() {
+            return;
+        }
+        let dir = tempfile::tempdir().unwrap();
+        // World-writable, so only the read-only root can stop the write.
+        std::fs::set_permissions(dir.path(), std::os::unix::fs::PermissionsExt::from_mode(0o777))
+            .unwrap();
+        let script = format!(
+            "touch {}/escaped 2>/dev/null; echo pid $$; echo hi > /tmp/t && cat /tmp/t; \
+             grep -c : /proc/net/dev; head -c 1 /dev/full 2>/dev/null | wc -c; \
+             head -c 1 /dev/zero | wc -c",
+            dir.path().display()
+        );
+        let (status, output) = run_sandboxed(&script);
+        assert!(status.success(), "{output}");
+        assert!(!dir.path().join("escaped").exists());
+        // init is pid 1; the loopback device is the only network device;
+        // /dev/full is behind nodev, /dev/zero is not.
+        assert_eq!(output, "pid 2\nhi\n1\n0\n1\n");
+    }
+
+    #[test]
+    fn program_runs_from_a_private_directory() {
+        if !available() {
+            return;
+        }
+        // Build directories are private to the user clings runs as. Run as
+        // root, the program itself runs as nobody, who cannot enter them.
+        let dir = tempfile::tempdir().unwrap();
+        std::fs::set_permissions(dir.path(), std::os::unix::fs::PermissionsExt::from_mode(0o700))
+            .unwrap();
+        let program = dir.path().join("echo");
+        std::fs::copy("/bin/echo", &program).unwrap();
+        let capture = Capture::new(4096);
+        let limits = RunLimits {
+            sandbox: true,
+            ..RunLimits::default()
+        };
+        let out = proc::run_captured(Command::new(&program).arg("hi"), None, &limits, &capture)
+            .unwrap();
+        assert!(out.status.success(), "{}", capture.text());
+        assert_eq!(capture.text(), "hi\n");
+    }
+
+    #[test]
+    fn program_status_passes_through() {
+        if !available() {
+            return;
+        }
+        use std::os::unix::process::ExitStatusExt;
+        assert_eq!(run_sandboxed("exit 3").0.code(), Some(3));
+        assert_eq!(run_sandboxed("kill -SEGV $$").0.signal(), Some(libc::SIGSEGV));
+    }
+
+    #[test]
+    fn filter_jumps_are_in_range() {
+        if let Some(filter) = seccomp::filter() {
+            assert!(filter.len() < 256);
+        }
+    }
+
+    /// Per-run cost of the sandbox, one run at a time and with every core
+    /// busy. Run with `cargo test --release -- --ignored --nocapture bench_sandbox`.
+    #[test]
+    #[ignore]
+    fn bench_sandbox() {
+        use std::time::{Duration, Instant};
+
+        if !available() {
+            return;
+        }
+        let run = |sandbox: bool| {
+            let limits = RunLimits {
+                sandbox,
+                ..RunLimits::default()
+            };
+            let capture = Capture::new(1024);
+            let out = proc::run_captured(&mut Command::new("true"), None, &limits, &capture).unwrap();
+            assert!(out.status.success());
+        };
+        let jobs = std::thread::available_parallelism().map_or(4, |n| n.get());
+        for sandbox in [false, true] {
+            let mut samples: Vec<Duration> = (0..200)
+                .map(|_| {
+                    let start = Instant::now();
+                    run(sandbox);
+                    start.elapsed()
+                })
+                .collect();
+            samples.sort();
+
+            let start = Instant::now();
+            std::thread::scope(|scope| {
+                for _ in 0..jobs {
+                    scope.spawn(|| (0..50).for_each(|_| run(sandbox)));
+                }
+            });
+            let parallel = start.elapsed() / (jobs as u32 * 50);
+
+            println!(
+                "sandbox {sandbox}: median {:?}, p90 {:?}, {jobs} jobs {:?}/run",
+                samples[samples.len() / 2],
+                samples[samples.len() * 9 / 10],
+                parallel
+            );
+        }
+    }
+}
@@ -1,3 +1,5 @@
+use crate::exercise::StageTiming;
+use crate::proc::Usage;
 use crossterm::style::{Attribute, Color, SetAttribute, SetForegroundColor};
 use std::io;
 
@@ -74,6 +76,49 @@ pub fn print_stage_output(stage: &str, output: &str) {
     }
 }
 
+/// Secondary detail under a result line, e.g. stage timings.
+pub fn print_dim(msg: &str) {
+    let mut stdout = io::stdout();
+    let _ = crossterm::execute!(stdout, SetForegroundColor(Color::DarkGrey));
+    println!("      {msg}\r");
+    let _ = crossterm::execute!(stdout, SetAttribute(Attribute::Reset));
+}
+
+pub fn print_timings(timings: &[StageTiming]) {
+    let mut stdout = io::stdout();
+    let _ = crossterm::execute!(stdout, SetForegroundColor(Color::DarkGrey));
+    println!("\r\n  ── timings ──\r");
+    let _ = crossterm::execute!(stdout, SetAttribute(Attribute::Reset));
+    println!(
+        "  {:<24} {:>9} {:>9} {:>9} {:>10}\r",
+        "stage", "wall", "user", "sys", "peak RSS"
+    );
+    for t in timings {
+        if t.cached {
+            println!("  {:<24} {:>9}\r", t.stage, "cached");
+            continue;
+        }
+        print_usage_row(t.stage, &t.usage);
+        if let Some(p) = &t.phases {
+            print_usage_row("  preprocess", &p.preprocess);
+            print_usage_row("  compile", &p.compile);
+            print_usage_row("  link", &p.link);
+        }
+    }
+}
+
+fn print_usage_row(label: &str, usage: &Usage) {
+    let ms = |d: std::time::Duration| format!("{:.1}ms", d.as_secs_f64() * 1000.0);
+    println!(
+        "  {:<24} {:>9} {:>9} {:>9} {:>7.1}MiB\r",
+        label,
+        ms(usage.wall),
+        ms(usage.user),
+        ms(usage.sys),
+        usage.max_rss_kib as f64 / 1024.0
+    );
+}
+
 pub fn clear_screen() {
     let _ = crossterm::execute!(
         io::stdout(),
@@ -0,0 +1,178 @@
+use crate::cache::Fingerprint;
+use crate::compiler::Compiler;
+use crate::exercise::{Exercise, VerifyResult};
+use crate::sandbox;
+use anyhow::{Context, Result};
+use serde::{Deserialize, Serialize};
+use std::collections::BTreeMap;
+use std::path::{Path, PathBuf};
+
+/// Everything a verify verdict depends on.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Inputs {
+    /// Fingerprint of the exercise source, the test harness and the
+    /// exercise's run settings (limits, output cap, sanitizer profile,
+    /// budgets, test isolation, sandbox).
+    pub source: String,
+    /// `Compiler::identity`.
+    pub compiler: String,
+    /// `Compiler::verify_flags`.
+    pub flags: Vec<String>,
+}
+
+impl Inputs {
+    pub fn new(compiler: &Compiler, exercise: &Exercise) -> Result<Self> {
+        let source = std::fs::read(&exercise.path)
+            .with_context(|| format!("Failed to read {}", exercise.path.display()))?;
+        let mut fp = Fingerprint::new();
+        fp.update(&source);
+        fp.update(&compiler.harness());
+        let info = &exercise.info;
+        fp.update(
+            format!(
+                "{:?} {:?} {:?} {:?} {:?}",
+                info.limits,
+                info.output_limit,
+                info.sanitizer,
+                info.budgets,
+                info.isolate_tests
+            )
+            .as_bytes(),
+        );
+        if sandbox::enabled() {
+            // A program may pass only while it can write files or connect.
+            fp.update(b"sandbox");
+        }
+        Ok(Self {
+            source: fp.hex(),
+            compiler: compiler.identity().to_string(),
+            flags: compiler.verify_flags(&exercise.info),
+        })
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+struct Entry {
+    #[serde(flatten)]
+    inputs: Inputs,
+    success: bool,
+    stage: String,
+}
+
+#[derive(Debug, Default, Serialize, Deserialize)]
+struct Entries {
+    #[serde(default)]
+    exercises: BTreeMap<String, Entry>,
+}
+
+/// Last verify verdict of every exercise, in `target/clings/verdicts.toml`.
+///
+/// `clings verify` skips an exercise whose inputs match its last passing
+/// verdict. Failures are always re-run, so their output is shown again.
+pub struct VerdictStore {
+    path: PathBuf,
+    entries: Entries,
+}
+
+impl VerdictStore {
+    /// Load the store in `build_dir`; an unreadable store starts out empty.
+    pub fn load(build_dir: &Path) -> Self {
+        let path = build_dir.join("verdicts.toml");
+        let entries = std::fs::read_to_string(&path)
+            .ok()
+            .and_then(|content| toml::from_str(&content).ok())
+            .unwrap_or_default();
+        Self { path, entries }
+    }
+
+    /// Whether `name` last passed with exactly these inputs.
+    pub fn passed(&self, name: &str, inputs: &Inputs) -> bool {
+        self.entries
+            .exercises
+            .get(name)
+            .is_some_and(|entry| entry.success && entry.inputs == *inputs)
+    }
+
+    pub fn record(&mut self, name: &str, inputs: Inputs, result: &VerifyResult) {
+        self.entries.exercises.insert(
+            name.to_string(),
+            Entry {
+                inputs,
+                success: result.success,
+                stage: result.stage.to_string(),
+            },
+        );
+    }
+
+    pub fn forget(&mut self, name: &str) {
+        self.entries.exercises.remove(name);
+    }
+
+    pub fn save(&self) -> Result<()> {
+        let dir = self.path.parent().unwrap_or(Path::new("."));
+        std::fs::create_dir_all(dir)?;
+        let tmp = self.path.with_extension(format!("toml.{}", std::process::id()));
+        std::fs::write(&tmp, toml::to_string(&self.entries)?)?;
+        std::fs::rename(&tmp, &self.path)?;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn inputs(source: &str) -> Inputs {
+        Inputs {
+            source: source.into(),
+            compiler: "/usr/bin/gcc-13 1000 42".into(),
+            flags: vec!["-Wall".into(), String::new(), "-DTEST".into()],
+        }
+    }
+
+    fn result(success: bool) -> VerifyResult {
+        VerifyResult {
+            success,
+            stage: if success { "complete" } else { "tests" },
+            output: String::new(),
+            timings: Vec::new(),
+            cached: false,
+            tests: Vec::new(),
+        }
+    }
+
+    #[test]
+    fn only_matching_passes_are_reused() {
+        let tmp = tempfile::tempdir().unwrap();
+        let mut store = VerdictStore::load(tmp.path());
+        store.record("good", inputs("a"), &result(true));
+        store.record("bad", inputs("b"), &result(false));
+
+        assert!(store.passed("good", &inputs("a")));
+        assert!(!store.passed("good", &inputs("changed")));
+        assert!(!store.passed("bad", &inputs("b")));
+        assert!(!store.passed("unknown", &inputs("a")));
+    }
+
+    #[test]
+    fn save_and_load_round_trip() {
+        let tmp = tempfile::tempdir().unwrap();
+        let mut store = VerdictStore::load(&tmp.path().join("nested"));
+        store.record("good", inputs("a"), &result(true));
+        store.record("gone", inputs("c"), &result(true));
+        store.forget("gone");
+        store.save().unwrap();
+
+        let store = VerdictStore::load(&tmp.path().join("nested"));
+        assert!(store.passed("good", &inputs("a")));
+        assert!(!store.passed("gone", &inputs("c")));
+    }
+
+    #[test]
+    fn garbage_loads_empty() {
+        let tmp = tempfile::tempdir().unwrap();
+        std::fs::write(tmp.path().join("verdicts.toml"), "not = [valid").unwrap();
+        let store = VerdictStore::load(tmp.path());
+        assert!(!store.passed("good", &inputs("a")));
+    }
+}
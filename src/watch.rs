@@ -1,34 +1,370 @@
 use crate::app_state::AppState;
 use crate::compiler::Compiler;
+use crate::exercise::{self, Exercise, VerifyResult};
+use crate::proc::{self, Cancel};
 use crate::term;
 use anyhow::Result;
 use crossterm::event::{self, Event, KeyCode, KeyModifiers};
 use crossterm::terminal::{EnterAlternateScreen, LeaveAlternateScreen};
-use notify_debouncer_mini::{new_debouncer, DebouncedEvent, DebouncedEventKind};
+use notify::event::{AccessKind, AccessMode};
+use notify::{EventKind, RecommendedWatcher, RecursiveMode, Watcher};
 use std::io;
-use std::path::Path;
-use std::sync::mpsc;
-use std::time::{Duration, SystemTime};
+use std::path::{Path, PathBuf};
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError, Sender};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::{Scope, ScopedJoinHandle};
+use std::time::{Duration, Instant, SystemTime};
 
 enum WatchEvent {
     FileChanged,
+    /// The current file saw writes and then none for the debounce window.
+    /// Produced by `next_event`, never sent.
+    Saved,
     Key(KeyCode),
     Quit,
+    /// A build started by `Builder::start` finished.
+    Verified {
+        id: u64,
+        verdict: Result<VerifyResult>,
+    },
+}
+
+/// How long a verdict took: since the save that triggered it, or since
+/// the build started for runs not caused by a save.
+struct Latency {
+    elapsed: Duration,
+    after_save: bool,
+    /// Built ahead of time in the background.
+    ahead: bool,
+}
+
+/// Ids of builds, unique across builders so results are never mixed up.
+static NEXT_BUILD_ID: AtomicU64 = AtomicU64::new(0);
+
+/// Verifies the current exercise on a worker thread, so keys and saves
+/// are handled while a build is in flight. Starting a build cancels the
+/// previous one, killing its compiler or program, so the loop always ends
+/// on the latest contents of the file.
+struct Builder<'scope, 'env> {
+    scope: &'scope Scope<'scope, 'env>,
+    compiler: &'env Compiler,
+    tx: Sender<WatchEvent>,
+    running: Option<Running<'scope>>,
+    /// Run builds at idle priority.
+    idle: bool,
+}
+
+struct Running<'scope> {
+    id: u64,
+    cancel: Cancel,
+    worker: ScopedJoinHandle<'scope, ()>,
+    started: Instant,
+    saved_at: Option<SystemTime>,
+}
+
+impl<'scope, 'env> Builder<'scope, 'env> {
+    fn new(
+        scope: &'scope Scope<'scope, 'env>,
+        compiler: &'env Compiler,
+        tx: Sender<WatchEvent>,
+        idle: bool,
+    ) -> Self {
+        Self {
+            scope,
+            compiler,
+            tx,
+            running: None,
+            idle,
+        }
+    }
+
+    fn start(&mut self, exercise: &Exercise, saved_at: Option<SystemTime>) {
+        self.cancel();
+        let id = NEXT_BUILD_ID.fetch_add(1, Ordering::Relaxed);
+        let cancel = Cancel::default();
+        let worker = {
+            let cancel = cancel.clone();
+            let exercise = exercise.clone();
+            let (compiler, tx) = (self.compiler, self.tx.clone());
+            let idle = self.idle;
+            self.scope.spawn(move || {
+                if idle {
+                    proc::lower_thread_priority();
+                }
+                let verdict = exercise.verify(compiler, Some(&cancel), true);
+                let _ = tx.send(WatchEvent::Verified { id, verdict });
+            })
+        };
+        self.running = Some(Running {
+            id,
+            cancel,
+            worker,
+            started: Instant::now(),
+            saved_at,
+        });
+    }
+
+    /// Kill the build in flight, if any. Its worker is not waited for: it
+    /// gives up at its next step, and builds never share a job directory.
+    fn cancel(&mut self) {
+        if let Some(running) = self.running.take() {
+            running.cancel.cancel();
+        }
+    }
+
+    /// Claim the result of build `id`. `None` means it was cancelled.
+    fn finish(&mut self, id: u64) -> Option<Latency> {
+        if self.running.as_ref().map(|r| r.id) != Some(id) {
+            return None;
+        }
+        let running = self.running.take()?;
+        let _ = running.worker.join();
+        let latency = match running.saved_at.and_then(|t| t.elapsed().ok()) {
+            Some(elapsed) => Latency {
+                elapsed,
+                after_save: true,
+                ahead: false,
+            },
+            None => Latency {
+                elapsed: running.started.elapsed(),
+                after_save: false,
+                ahead: false,
+            },
+        };
+        Some(latency)
+    }
+}
+
+/// Builds the exercise `n` would move to, at idle priority, while the user
+/// looks at a passing verdict. Navigating there shows the stored verdict at
+/// once, unless the file was modified since the build started; even then
+/// the compiles it finished are in the build cache.
+struct Ahead<'scope, 'env> {
+    builder: Builder<'scope, 'env>,
+    /// Exercise index and its mtime when the build started.
+    target: Option<(usize, Option<SystemTime>)>,
+    verdict: Option<VerifyResult>,
+}
+
+impl<'scope, 'env> Ahead<'scope, 'env> {
+    fn new(builder: Builder<'scope, 'env>) -> Self {
+        Self {
+            builder,
+            target: None,
+            verdict: None,
+        }
+    }
+
+    /// Start building the upcoming exercise unless that is already done.
+    fn speculate(&mut self, state: &AppState) {
+        let Some(index) = state.upcoming() else {
+            return;
+        };
+        let exercise = &state.exercises[index];
+        let mtime = file_mtime(&exercise.path);
+        if self.target == Some((index, mtime)) || !exercise.exists() {
+            return;
+        }
+        self.verdict = None;
+        self.target = Some((index, mtime));
+        self.builder.start(exercise, None);
+    }
+
+    /// Keep the result of build `id` if it is ours.
+    fn finished(&mut self, id: u64, verdict: Result<VerifyResult>) {
+        if self.builder.finish(id).is_some() {
+            // A failure to run the build (not a failing exercise) is not kept.
+            self.verdict = verdict.ok();
+        }
+    }
+
+    /// The verdict for exercise `index`, if built ahead from its current
+    /// contents. Anything built for `index` is dropped either way.
+    fn take(&mut self, index: usize, exercise: &Exercise) -> Option<VerifyResult> {
+        let (target, mtime) = self.target?;
+        if target != index {
+            return None;
+        }
+        let verdict = self.verdict.take();
+        self.forget(index);
+        verdict.filter(|_| file_mtime(&exercise.path) == mtime)
+    }
+
+    /// Stop building `index` ahead, so it is never built twice at once.
+    fn forget(&mut self, index: usize) {
+        if self.target.is_some_and(|(target, _)| target == index) {
+            self.builder.cancel();
+            self.target = None;
+            self.verdict = None;
+        }
+    }
+
+    fn cancel(&mut self) {
+        self.builder.cancel();
+    }
+}
+
+/// Bounds of the quiet period that ends a save.
+const MIN_QUIET: Duration = Duration::from_millis(20);
+const MAX_QUIET: Duration = Duration::from_millis(50);
+
+/// How long the current file must see no writes before it is rebuilt.
+///
+/// Editors save in one or several steps (truncate and write, or write a
+/// temp file and rename it). The window follows the largest gap seen
+/// inside recent saves, so a single-write save builds after `MIN_QUIET`
+/// while a multi-step one is not caught half-written.
+struct Debounce {
+    quiet: Duration,
+}
+
+impl Debounce {
+    fn new() -> Self {
+        Self { quiet: MIN_QUIET }
+    }
+
+    /// Adjust to a finished save whose events were at most `max_gap` apart.
+    fn learn(&mut self, max_gap: Duration) {
+        let target = (max_gap * 2).clamp(MIN_QUIET, MAX_QUIET);
+        self.quiet = (self.quiet + target) / 2;
+    }
+}
+
+/// Watches the current exercise file.
+///
+/// The watch is placed on the file's directory, not on the file: editors
+/// that save by renaming a temp file over the original replace the inode a
+/// file watch is attached to. Events for other files in that directory are
+/// dropped in the notify thread, so they never wake the main loop.
+struct ExerciseWatch {
+    watcher: RecommendedWatcher,
+    target: Arc<Mutex<PathBuf>>,
+    dir: Option<PathBuf>,
+}
+
+impl ExerciseWatch {
+    fn new(tx: Sender<WatchEvent>) -> Result<Self> {
+        let target = Arc::new(Mutex::new(PathBuf::new()));
+        let current = Arc::clone(&target);
+        let watcher = notify::recommended_watcher(move |res: notify::Result<notify::Event>| {
+            let Ok(event) = res else { return };
+            if !is_write(&event.kind) {
+                return;
+            }
+            let target = current.lock().unwrap_or_else(|e| e.into_inner());
+            if event.paths.contains(&*target) {
+                let _ = tx.send(WatchEvent::FileChanged);
+            }
+        })?;
+        Ok(Self {
+            watcher,
+            target,
+            dir: None,
+        })
+    }
+
+    /// Follow the current exercise after navigating to it.
+    fn retarget(&mut self, state: &AppState) {
+        let Some(file) = state.current_exercise().map(|e| e.path.clone()) else {
+            return;
+        };
+        let dir = file.parent().map(Path::to_path_buf);
+        *self.target.lock().unwrap_or_else(|e| e.into_inner()) = file;
+        if dir == self.dir {
+            return;
+        }
+        if let Some(old) = self.dir.take() {
+            let _ = self.watcher.unwatch(&old);
+        }
+        // A missing directory means a missing exercise, which is reported
+        // on screen; there is nothing to watch until the user navigates.
+        if let Some(dir) = dir {
+            if self.watcher.watch(&dir, RecursiveMode::NonRecursive).is_ok() {
+                self.dir = Some(dir);
+            }
+        }
+    }
+}
+
+/// Whether `kind` may change file contents. Opens and reads are dropped,
+/// which also keeps the compiler reading the file from triggering a rerun.
+fn is_write(kind: &EventKind) -> bool {
+    match kind {
+        EventKind::Access(AccessKind::Close(AccessMode::Write)) => true,
+        EventKind::Access(_) => false,
+        _ => true,
+    }
+}
+
+/// Writes to the current file whose quiet period has not yet passed.
+struct PendingSave {
+    last: Instant,
+    max_gap: Duration,
+}
+
+/// Wait for whatever the main loop must handle next: a key, a finished
+/// build, or the end of a save.
+///
+/// File events never reach the loop; they only (re)arm the save timer, and
+/// `Saved` is returned once the timer runs out. Keys and build results are
+/// returned as they arrive, also while a save is settling, so the loop
+/// never blocks on anything but this channel. `None` once every sender is
+/// gone.
+fn next_event(
+    rx: &Receiver<WatchEvent>,
+    pending: &mut Option<PendingSave>,
+    debounce: &mut Debounce,
+) -> Option<WatchEvent> {
+    loop {
+        let event = match pending {
+            Some(save) => {
+                let wait = (save.last + debounce.quiet).saturating_duration_since(Instant::now());
+                match rx.recv_timeout(wait) {
+                    Ok(event) => event,
+                    Err(RecvTimeoutError::Timeout) => {
+                        let save = pending.take()?;
+                        debounce.learn(save.max_gap);
+                        return Some(WatchEvent::Saved);
+                    }
+                    Err(RecvTimeoutError::Disconnected) => return None,
+                }
+            }
+            None => rx.recv().ok()?,
+        };
+        match event {
+            WatchEvent::FileChanged => {
+                let now = Instant::now();
+                match pending {
+                    Some(save) => {
+                        save.max_gap = save.max_gap.max(now - save.last);
+                        save.last = now;
+                    }
+                    None => {
+                        *pending = Some(PendingSave {
+                            last: now,
+                            max_gap: Duration::ZERO,
+                        })
+                    }
+                }
+            }
+            other => return Some(other),
+        }
+    }
 }
 
 /// Get the mtime of the current exercise file, if available.
 fn current_exercise_mtime(state: &AppState) -> Option<SystemTime> {
-    state
-        .current_exercise()
-        .and_then(|e| e.path.metadata().ok())
-        .and_then(|m| m.modified().ok())
+    state.current_exercise().and_then(|e| file_mtime(&e.path))
+}
+
+fn file_mtime(path: &Path) -> Option<SystemTime> {
+    path.metadata().ok().and_then(|m| m.modified().ok())
 }
 
 pub fn run_watch(
     state: &mut AppState,
     compiler: &Compiler,
-    exercises_dir: &Path,
-    build_dir: &Path,
     welcome: Option<&str>,
 ) -> Result<()> {
     let (tx, rx) = mpsc::channel();
@@ -37,33 +373,16 @@ pub fn run_watch(
     let mut hint_level: usize = 0;
 
     // Track whether the last run of the current exercise succeeded
-    let mut last_run_success;
+    let mut last_run_success = false;
 
     // Track exercise mtime to avoid spurious refreshes
     let mut last_mtime = current_exercise_mtime(state);
 
-    // File watcher
-    let tx_fs = tx.clone();
-    let mut debouncer = new_debouncer(
-        Duration::from_millis(500),
-        move |res: Result<Vec<DebouncedEvent>, notify::Error>| {
-            if let Ok(events) = res {
-                for event in events {
-                    if event.kind == DebouncedEventKind::Any {
-                        let path_str = event.path.to_string_lossy().to_string();
-                        if path_str.ends_with(".c") {
-                            let _ = tx_fs.send(WatchEvent::FileChanged);
-                        }
-                    }
-                }
-            }
-        },
-    )?;
-
-    debouncer.watcher().watch(
-        exercises_dir,
-        notify::RecursiveMode::Recursive,
-    )?;
+    // File watcher, following the current exercise
+    let mut watch = ExerciseWatch::new(tx.clone())?;
+    watch.retarget(state);
+    let mut debounce = Debounce::new();
+    let mut pending = None;
 
     // Show welcome message before entering alternate screen
     if let Some(msg) = welcome {
@@ -82,14 +401,6 @@ pub fn run_watch(
     crossterm::execute!(io::stdout(), EnterAlternateScreen)?;
     crossterm::terminal::enable_raw_mode()?;
 
-    // Initial run
-    print_watch_header(state, compiler);
-    last_run_success = run_current_exercise(state, compiler, build_dir);
-    print_watch_commands();
-
-    // Drain any events that arrived during initial compilation
-    while rx.try_recv().is_ok() {}
-
     // Keyboard reader thread
     let tx_key = tx.clone();
     std::thread::spawn(move || loop {
@@ -104,130 +415,165 @@ pub fn run_watch(
         }
     });
 
-    loop {
-        match rx.recv() {
-            Ok(WatchEvent::FileChanged) => {
-                // Only re-render if the exercise file actually changed
-                let new_mtime = current_exercise_mtime(state);
-                if new_mtime == last_mtime {
-                    continue;
-                }
-                last_mtime = new_mtime;
+    std::thread::scope(|scope| -> Result<()> {
+        let mut builder = Builder::new(scope, compiler, tx.clone(), false);
+        let mut ahead = Ahead::new(Builder::new(scope, compiler, tx, true));
 
-                term::clear_screen();
-                print_watch_header(state, compiler);
-                last_run_success = run_current_exercise(state, compiler, build_dir);
-                print_watch_commands();
+        // Initial run
+        start_run(state, compiler, &mut builder, None);
 
-                // Drain events that arrived during compilation
-                while rx.try_recv().is_ok() {}
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('n'))) => {
-                // Mark current as done only if it passed, then advance
-                if last_run_success {
-                    if let Some(name) = state.current_exercise().map(|e| e.name().to_string()) {
-                        state.mark_done(&name);
+        loop {
+            match next_event(&rx, &mut pending, &mut debounce) {
+                Some(WatchEvent::Saved) => {
+                    // Only rebuild if the exercise file actually changed
+                    let new_mtime = current_exercise_mtime(state);
+                    if new_mtime == last_mtime {
+                        continue;
                     }
+                    last_mtime = new_mtime;
+
+                    // Replaces (and kills) a build of older contents.
+                    last_run_success = false;
+                    start_run(state, compiler, &mut builder, new_mtime);
                 }
-                if state.all_done() {
-                    term::clear_screen();
-                    println!("\r");
-                    term::print_success("All exercises completed! Congratulations!");
-                    println!("\r");
-                    break;
+                Some(WatchEvent::Verified { id, verdict }) => {
+                    // Results of cancelled builds are dropped here.
+                    match builder.finish(id) {
+                        Some(latency) => {
+                            last_run_success = show_verdict(state, compiler, verdict, latency);
+                            if last_run_success {
+                                ahead.speculate(state);
+                            }
+                        }
+                        None => ahead.finished(id, verdict),
+                    }
                 }
-                state.next_pending();
-                state.save()?;
-                hint_level = 0; // Reset hints for new exercise
-                last_mtime = current_exercise_mtime(state);
-                term::clear_screen();
-                print_watch_header(state, compiler);
-                last_run_success = run_current_exercise(state, compiler, build_dir);
-                print_watch_commands();
-                while rx.try_recv().is_ok() {}
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('p'))) => {
-                // Go back to previous exercise
-                if state.prev() {
+                Some(WatchEvent::Key(KeyCode::Char('n'))) => {
+                    // Mark current as done only if it passed, then advance
+                    if last_run_success {
+                        if let Some(name) = state.current_exercise().map(|e| e.name().to_string()) {
+                            state.mark_done(&name);
+                        }
+                    }
+                    if state.all_done() {
+                        builder.cancel();
+                        ahead.cancel();
+                        term::clear_screen();
+                        println!("\r");
+                        term::print_success("All exercises completed! Congratulations!");
+                        println!("\r");
+                        break;
+                    }
+                    state.next_pending();
                     state.save()?;
-                    hint_level = 0;
+                    watch.retarget(state);
+                    hint_level = 0; // Reset hints for new exercise
                     last_mtime = current_exercise_mtime(state);
-                    term::clear_screen();
-                    print_watch_header(state, compiler);
-                    last_run_success = run_current_exercise(state, compiler, build_dir);
-                    print_watch_commands();
-                    while rx.try_recv().is_ok() {}
-                }
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('h'))) => {
-                // Show progressive hint
-                if let Some(exercise) = state.current_exercise() {
-                    let hints = exercise.hints();
-                    term::clear_screen();
-                    print_watch_header(state, compiler);
-                    println!("\r");
-
-                    if hints.is_empty() {
-                        term::print_warning("No hints available for this exercise.");
-                    } else {
-                        let current = hint_level.min(hints.len() - 1);
-                        for i in 0..=current {
-                            term::print_header(&format!("Hint {} of {}:", i + 1, hints.len()));
-                            println!("\r");
-                            for line in hints[i].lines() {
-                                println!("  {line}\r");
+                    let started = Instant::now();
+                    let index = state.current_index;
+                    match state.current_exercise().and_then(|e| ahead.take(index, e)) {
+                        Some(result) => {
+                            // Drop the build of the exercise we just left.
+                            builder.cancel();
+                            let latency = Latency {
+                                elapsed: started.elapsed(),
+                                after_save: false,
+                                ahead: true,
+                            };
+                            last_run_success = show_verdict(state, compiler, Ok(result), latency);
+                            if last_run_success {
+                                ahead.speculate(state);
                             }
-                            println!("\r");
                         }
+                        None => {
+                            last_run_success = false;
+                            start_run(state, compiler, &mut builder, None);
+                        }
+                    }
+                }
+                Some(WatchEvent::Key(KeyCode::Char('p'))) => {
+                    // Go back to previous exercise
+                    if state.prev() {
+                        state.save()?;
+                        watch.retarget(state);
+                        ahead.forget(state.current_index);
+                        hint_level = 0;
+                        last_mtime = current_exercise_mtime(state);
+                        last_run_success = false;
+                        start_run(state, compiler, &mut builder, None);
+                    }
+                }
+                Some(WatchEvent::Key(KeyCode::Char('h'))) => {
+                    // Show progressive hint
+                    if let Some(exercise) = state.current_exercise() {
+                        let hints = exercise.hints();
+                        term::clear_screen();
+                        print_watch_header(state, compiler, &[]);
+                        println!("\r");
 
-                        if current + 1 < hints.len() {
-                            hint_level = current + 1;
-                            term::print_info(&format!(
-                                "Press 'h' again for the next hint ({} more).",
-                                hints.len() - current - 1
-                            ));
+                        if hints.is_empty() {
+                            term::print_warning("No hints available for this exercise.");
                         } else {
-                            term::print_info("No more hints. You've seen them all!");
+                            let current = hint_level.min(hints.len() - 1);
+                            for i in 0..=current {
+                                term::print_header(&format!("Hint {} of {}:", i + 1, hints.len()));
+                                println!("\r");
+                                for line in hints[i].lines() {
+                                    println!("  {line}\r");
+                                }
+                                println!("\r");
+                            }
+
+                            if current + 1 < hints.len() {
+                                hint_level = current + 1;
+                                term::print_info(&format!(
+                                    "Press 'h' again for the next hint ({} more).",
+                                    hints.len() - current - 1
+                                ));
+                            } else {
+                                term::print_info("No more hints. You've seen them all!");
+                            }
                         }
+                        println!("\r");
+                        print_watch_commands();
+                    }
+                }
+                Some(WatchEvent::Key(KeyCode::Char('l'))) => {
+                    // List exercises
+                    term::clear_screen();
+                    println!("\r");
+                    term::print_header("Exercises:");
+                    println!("\r");
+                    for (i, ex) in state.exercises.iter().enumerate() {
+                        let status = if state.is_done(ex.name()) {
+                            "✓"
+                        } else if i == state.current_index {
+                            "→"
+                        } else {
+                            " "
+                        };
+                        println!("  {status} {}\r", ex.name());
                     }
                     println!("\r");
                     print_watch_commands();
                 }
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('l'))) => {
-                // List exercises
-                term::clear_screen();
-                println!("\r");
-                term::print_header("Exercises:");
-                println!("\r");
-                for (i, ex) in state.exercises.iter().enumerate() {
-                    let status = if state.is_done(ex.name()) {
-                        "✓"
-                    } else if i == state.current_index {
-                        "→"
-                    } else {
-                        " "
-                    };
-                    println!("  {status} {}\r", ex.name());
+                Some(WatchEvent::Key(KeyCode::Char('r'))) => {
+                    // Re-run current exercise
+                    last_run_success = false;
+                    start_run(state, compiler, &mut builder, None);
                 }
-                println!("\r");
-                print_watch_commands();
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('r'))) => {
-                // Re-run current exercise
-                term::clear_screen();
-                print_watch_header(state, compiler);
-                last_run_success = run_current_exercise(state, compiler, build_dir);
-                print_watch_commands();
-                while rx.try_recv().is_ok() {}
-            }
-            Ok(WatchEvent::Key(KeyCode::Char('q'))) | Ok(WatchEvent::Quit) => {
-                break;
+                Some(WatchEvent::Key(KeyCode::Char('q'))) | Some(WatchEvent::Quit) | None => {
+                    break;
+                }
+                Some(_) => {}
             }
-            Ok(_) => {}
-            Err(_) => break,
         }
-    }
+
+        // Do not let the scope wait for builds nobody will look at.
+        builder.cancel();
+        ahead.cancel();
+        Ok(())
+    })?;
 
     crossterm::terminal::disable_raw_mode()?;
     crossterm::execute!(io::stdout(), LeaveAlternateScreen)?;
@@ -235,7 +581,40 @@ pub fn run_watch(
     Ok(())
 }
 
-fn print_watch_header(state: &AppState, compiler: &Compiler) {
+/// Redraw the screen for the current exercise and start verifying it.
+/// `saved_at` is the mtime of the save that triggered the run, if any.
+fn start_run(
+    state: &AppState,
+    compiler: &Compiler,
+    builder: &mut Builder,
+    saved_at: Option<SystemTime>,
+) {
+    term::clear_screen();
+    print_watch_header(state, compiler, &[]);
+    match state.current_exercise() {
+        Some(exercise) => {
+            print_exercise(exercise);
+            if exercise.exists() {
+                term::print_info("Building...");
+                builder.start(exercise, saved_at);
+            } else {
+                builder.cancel();
+                term::print_error(&format!(
+                    "Exercise file not found: {}",
+                    exercise.path.display()
+                ));
+            }
+        }
+        None => {
+            builder.cancel();
+            term::print_warning("No exercises found.");
+        }
+    }
+    print_watch_commands();
+}
+
+/// Title and progress bar, then `timings` of the verdict shown below it.
+fn print_watch_header(state: &AppState, compiler: &Compiler, timings: &[String]) {
     let (done, total) = state.progress();
     println!("\r");
     term::print_header(&format!(
@@ -245,6 +624,9 @@ fn print_watch_header(state: &AppState, compiler: &Compiler) {
         total
     ));
     term::print_progress(done, total);
+    for line in timings {
+        term::print_dim(line);
+    }
     println!("\r");
 }
 
@@ -262,28 +644,46 @@ fn print_watch_commands() {
     );
 }
 
-fn run_current_exercise(state: &AppState, compiler: &Compiler, build_dir: &Path) -> bool {
-    let exercise = match state.current_exercise() {
-        Some(e) => e,
-        None => {
-            term::print_warning("No exercises found.");
-            return false;
+/// Redraw the screen with the verdict of the current exercise and return
+/// whether it passed.
+fn show_verdict(
+    state: &AppState,
+    compiler: &Compiler,
+    verdict: Result<VerifyResult>,
+    latency: Latency,
+) -> bool {
+    let mut timings = vec![format!(
+        "Verdict in {} ms{}{}",
+        latency.elapsed.as_millis(),
+        if latency.after_save { " after save" } else { "" },
+        if latency.ahead { " (built ahead)" } else { "" }
+    )];
+    if let Ok(result) = &verdict {
+        timings.push(exercise::compact_timings(&result.timings));
+    }
+
+    term::clear_screen();
+    print_watch_header(state, compiler, &timings);
+    let passed = match state.current_exercise() {
+        Some(exercise) => {
+            print_exercise(exercise);
+            print_verdict(exercise, verdict)
         }
+        None => false,
     };
+    print_watch_commands();
+    passed
+}
 
+fn print_exercise(exercise: &Exercise) {
     println!("  Exercise: {}\r", exercise.name());
     println!("  File: {}\r", exercise.path.display());
     println!("\r");
+}
 
-    if !exercise.exists() {
-        term::print_error(&format!(
-            "Exercise file not found: {}",
-            exercise.path.display()
-        ));
-        return false;
-    }
-
-    match exercise.verify(compiler, build_dir) {
+/// Print the verdict of a finished build and return whether it passed.
+fn print_verdict(exercise: &Exercise, verdict: Result<VerifyResult>) -> bool {
+    match verdict {
         Ok(result) => {
             if result.success {
                 term::print_success(&format!("{} compiled and ran successfully!", exercise.name()));
@@ -305,3 +705,56 @@ fn run_current_exercise(state: &AppState, compiler: &Compiler, build_dir: &Path)
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use notify::event::{CreateKind, DataChange, ModifyKind};
+
+    #[test]
+    fn debounce_stays_within_bounds() {
+        let mut debounce = Debounce::new();
+        assert_eq!(debounce.quiet, MIN_QUIET);
+        for _ in 0..10 {
+            debounce.learn(Duration::from_secs(1));
+        }
+        assert!(debounce.quiet <= MAX_QUIET);
+        assert!(debounce.quiet > MAX_QUIET - Duration::from_millis(1));
+        for _ in 0..10 {
+            debounce.learn(Duration::ZERO);
+        }
+        assert!(debounce.quiet >= MIN_QUIET);
+        assert!(debounce.quiet < MIN_QUIET + Duration::from_millis(1));
+    }
+
+    #[test]
+    fn keys_are_not_held_back_by_a_settling_save() {
+        let (tx, rx) = mpsc::channel();
+        let (mut pending, mut debounce) = (None, Debounce::new());
+        tx.send(WatchEvent::FileChanged).unwrap();
+        tx.send(WatchEvent::Key(KeyCode::Char('h'))).unwrap();
+
+        let started = Instant::now();
+        let first = next_event(&rx, &mut pending, &mut debounce);
+        assert!(matches!(first, Some(WatchEvent::Key(KeyCode::Char('h')))));
+        assert!(started.elapsed() < MIN_QUIET);
+        assert!(pending.is_some());
+
+        let second = next_event(&rx, &mut pending, &mut debounce);
+        assert!(matches!(second, Some(WatchEvent::Saved)));
+        assert!(started.elapsed() >= MIN_QUIET);
+        assert!(pending.is_none());
+
+        drop(tx);
+        assert!(next_event(&rx, &mut pending, &mut debounce).is_none());
+    }
+
+    #[test]
+    fn reads_are_not_writes() {
+        assert!(is_write(&EventKind::Modify(ModifyKind::Data(DataChange::Content))));
+        assert!(is_write(&EventKind::Create(CreateKind::File)));
+        assert!(is_write(&EventKind::Access(AccessKind::Close(AccessMode::Write))));
+        assert!(!is_write(&EventKind::Access(AccessKind::Open(AccessMode::Any))));
+        assert!(!is_write(&EventKind::Access(AccessKind::Close(AccessMode::Read))));
+    }
+}
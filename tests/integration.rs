@@ -107,6 +107,118 @@ fn compile_invalid_c_file() {
     assert!(!result.status.success(), "gcc should fail on invalid C");
 }
 
+#[test]
+fn harness_benchmarks_report_stats() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let source = tmp.path().join("bench.c");
+    std::fs::write(
+        &source,
+        r#"#include "clings_test.h"
+static int data[10000];
+static volatile int small_n = 10, large_n = 10000;
+static int sum(int n) { int s = 0; for (int i = 0; i < n; i++) s += data[i]; return s; }
+BENCH(bench_small) { DO_NOT_OPTIMIZE(sum(small_n)); }
+BENCH(bench_large) { DO_NOT_OPTIMIZE(sum(large_n)); }
+TEST(test_large_is_slower) {
+    RUN_BENCH(bench_small, 10);
+    double small = clings_bench_last.median_ns;
+    RUN_BENCH(bench_large, 10);
+    ASSERT(clings_bench_last.min_ns <= clings_bench_last.median_ns);
+    ASSERT(clings_bench_last.median_ns <= clings_bench_last.p99_ns);
+    ASSERT(clings_bench_last.median_ns > small);
+}
+int main(void) {
+    for (int i = 0; i < 10000; i++) data[i] = i;
+    RUN_TEST(test_large_is_slower);
+    TEST_REPORT();
+}
+"#,
+    )
+    .unwrap();
+
+    let binary = tmp.path().join("bench");
+    let include = concat!("-I", env!("CARGO_MANIFEST_DIR"), "/include");
+    let result = Command::new("gcc")
+        .args(["-Wall", "-Wextra", "-Werror", "-pedantic", "-std=c11", "-O2", include, "-o"])
+        .arg(&binary)
+        .arg(&source)
+        .output()
+        .unwrap();
+    assert!(
+        result.status.success(),
+        "harness should build warning-free: {}",
+        String::from_utf8_lossy(&result.stderr)
+    );
+
+    let run = Command::new(&binary).output().unwrap();
+    let stdout = String::from_utf8_lossy(&run.stdout);
+    assert!(run.status.success(), "got: {stdout}");
+    assert!(stdout.contains("bench bench_large"), "got: {stdout}");
+    assert!(stdout.contains("median"), "got: {stdout}");
+}
+
+#[test]
+fn harness_children_do_not_wait_on_their_output() {
+    if !has_gcc() || !cfg!(unix) {
+        eprintln!("skipping: needs gcc and fork");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let source = tmp.path().join("chatty.c");
+    // test_chatty fills its pipe long before test_slow, the oldest child,
+    // is done; it must not have to wait for its turn to keep running.
+    std::fs::write(
+        &source,
+        r#"#include <stdio.h>
+#include "clings_test.h"
+static void spin(double secs) { double t = clings_now_ns(); while (clings_now_ns() - t < secs * 1e9) {} }
+static volatile int counter;
+BENCH(bench_inc) { counter++; }
+TEST(test_slow) { spin(1.2); ASSERT(1); }
+TEST(test_chatty) {
+    for (int i = 0; i < 50000; i++) printf("chatter %d\n", i);
+    spin(1.0);
+    ASSERT(1);
+}
+int main(void) {
+    RUN_BENCH(bench_inc, 5);
+    RUN_TEST(test_slow);
+    RUN_TEST(test_chatty);
+    TEST_REPORT();
+}
+"#,
+    )
+    .unwrap();
+
+    let binary = tmp.path().join("chatty");
+    let include = concat!("-I", env!("CARGO_MANIFEST_DIR"), "/include");
+    let result = Command::new("gcc")
+        .args(["-Wall", "-Wextra", "-Werror", "-pedantic", "-std=c11", "-DTEST", include, "-o"])
+        .arg(&binary)
+        .arg(&source)
+        .output()
+        .unwrap();
+    assert!(result.status.success(), "{}", String::from_utf8_lossy(&result.stderr));
+
+    let run = Command::new(&binary)
+        .env("CLINGS_TEST_JOBS", "2")
+        .env("CLINGS_TEST_TIMEOUT", "2")
+        .env("CLINGS_REPORT", "1")
+        .output()
+        .unwrap();
+    let stdout = String::from_utf8_lossy(&run.stdout);
+    assert!(stdout.contains("2 tests, 2 passed, 0 failed"), "got: {stdout}");
+    assert!(stdout.contains("chatter 49999"), "got: {stdout}");
+    // The parent's benchmark is reported once, not again by every child.
+    assert_eq!(stdout.matches("\"bench\":\"bench_inc\"").count(), 1, "got: {stdout}");
+}
+
 // ---- CLI integration tests ----
 
 #[test]
@@ -191,6 +303,408 @@ fn cli_verify_fails_on_broken_exercise() {
     );
 }
 
+#[test]
+fn cli_verify_parallel_keeps_info_order() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let ok = "#include <stdio.h>\nint main(void) { return 0; }\n";
+    setup_project(
+        tmp.path(),
+        &[
+            ("zeta", "00_intro", ok),
+            ("alpha", "00_intro", "not valid C;\n"),
+            ("mid", "01_next", ok),
+        ],
+    );
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--jobs", "3"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+
+    assert!(
+        !output.status.success(),
+        "verify should still fail when one exercise is broken"
+    );
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let zeta = stdout.find("zeta").expect("zeta reported");
+    let alpha = stdout.find("alpha").expect("alpha reported");
+    let mid = stdout.find("mid").expect("mid reported");
+    assert!(
+        zeta < alpha && alpha < mid,
+        "results should follow info.toml order, got: {stdout}"
+    );
+}
+
+#[test]
+fn cli_verify_jsonl_emits_one_record_per_exercise() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    setup_project(
+        tmp.path(),
+        &[
+            ("good", "00_intro", "int main(void) { return 0; }\n"),
+            ("bad", "00_intro", "not valid C;\n"),
+        ],
+    );
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+
+    assert!(!output.status.success(), "exit code should reflect the failure");
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let records: Vec<serde_json::Value> = stdout
+        .lines()
+        .map(|line| serde_json::from_str(line).expect("every line is a JSON record"))
+        .collect();
+    assert_eq!(records.len(), 2, "got: {stdout}");
+
+    let bad = records.iter().find(|r| r["name"] == "bad").unwrap();
+    assert_eq!(bad["success"], false);
+    assert_eq!(bad["stage"], "compilation");
+    assert_eq!(bad["dir"], "00_intro");
+    let good = records.iter().find(|r| r["name"] == "good").unwrap();
+    assert_eq!(good["success"], true);
+    assert_eq!(good["stage"], "complete");
+}
+
+#[test]
+fn cli_verify_timings_split_compile_phases() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    setup_project(
+        tmp.path(),
+        &[
+            ("good", "00_intro", "int main(void) { return 0; }\n"),
+            ("bad", "00_intro", "int main(void) { return missing; }\n"),
+        ],
+    );
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--timings", "--format", "jsonl"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let records: Vec<serde_json::Value> = stdout
+        .lines()
+        .map(|line| serde_json::from_str(line).unwrap())
+        .collect();
+    let good = records.iter().find(|r| r["name"] == "good").unwrap();
+    assert_eq!(good["success"], true, "got: {stdout}");
+    let phases = &good["stages"][0]["phases"];
+    for phase in ["preprocess_ms", "compile_ms", "link_ms"] {
+        assert!(phases[phase].as_f64().unwrap() > 0.0, "got: {stdout}");
+    }
+
+    let bad = records.iter().find(|r| r["name"] == "bad").unwrap();
+    assert_eq!(bad["stage"], "compilation");
+    assert!(
+        bad["output"].as_str().unwrap().contains("bad.c"),
+        "diagnostics should name the source, got: {stdout}"
+    );
+    assert_eq!(bad["stages"][0]["phases"]["link_ms"], 0.0);
+}
+
+#[test]
+fn cli_verify_skips_unchanged_exercises() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    setup_project(
+        tmp.path(),
+        &[
+            ("one", "00_intro", "int main(void) { return 0; }\n"),
+            ("two", "00_intro", "int main(void) { return 0; }\n"),
+        ],
+    );
+    let cached = |args: &[&str]| -> Vec<(String, bool)> {
+        let output = Command::new(clings_bin())
+            .args(["verify", "--format", "jsonl"])
+            .args(args)
+            .current_dir(tmp.path())
+            .output()
+            .unwrap();
+        assert!(output.status.success());
+        let mut records: Vec<(String, bool)> = String::from_utf8_lossy(&output.stdout)
+            .lines()
+            .map(|line| {
+                let record: serde_json::Value = serde_json::from_str(line).unwrap();
+                (record["name"].as_str().unwrap().to_string(), record["cached"] == true)
+            })
+            .collect();
+        records.sort();
+        records
+    };
+
+    assert_eq!(cached(&[]), [("one".into(), false), ("two".into(), false)]);
+    assert_eq!(cached(&[]), [("one".into(), true), ("two".into(), true)]);
+
+    std::fs::write(
+        tmp.path().join("exercises/00_intro/two.c"),
+        "int main(void) { return 0; } /* edited */\n",
+    )
+    .unwrap();
+    assert_eq!(cached(&[]), [("one".into(), true), ("two".into(), false)]);
+    assert_eq!(cached(&["--force"]), [("one".into(), false), ("two".into(), false)]);
+}
+
+#[test]
+fn cli_verify_enforces_performance_budgets() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let code = r#"#ifndef TEST
+int main(void) { return 0; }
+#else
+#include "clings_test.h"
+static volatile int n = 1000;
+BENCH(bench_loop) { int s = 0; for (int i = 0; i < n; i++) s += i; DO_NOT_OPTIMIZE(s); }
+int main(void) { RUN_BENCH(bench_loop, 10); TEST_REPORT(); }
+#endif
+"#;
+    setup_project(tmp.path(), &[("perf", "06_perf", code)]);
+
+    let verify_with_budget = |limits: &str| -> serde_json::Value {
+        std::fs::write(
+            tmp.path().join("info.toml"),
+            format!(
+                "format_version = 1\n\n[[exercises]]\nname = \"perf\"\ndir = \"06_perf\"\n\
+                 budgets = [{{ bench = \"bench_loop\", {limits} }}]\n"
+            ),
+        )
+        .unwrap();
+        let output = Command::new(clings_bin())
+            .args(["verify", "--format", "jsonl"])
+            .current_dir(tmp.path())
+            .output()
+            .unwrap();
+        let stdout = String::from_utf8_lossy(&output.stdout);
+        serde_json::from_str(stdout.lines().next().expect("one record")).unwrap()
+    };
+
+    let generous = verify_with_budget("max_ns = 1e9, max_allocs = 0");
+    assert_eq!(generous["stage"], "complete", "got: {generous}");
+
+    let tight = verify_with_budget("max_ns = 0.001");
+    assert_eq!(tight["stage"], "performance", "got: {tight}");
+    let output = tight["output"].as_str().unwrap();
+    assert!(output.contains("FAILED  bench_loop"), "got: {output}");
+    assert!(!output.contains("#clings"), "report lines should be hidden: {output}");
+}
+
+#[test]
+fn cli_verify_tests_catch_leaks_without_sanitizers() {
+    if !has_gcc() || !cfg!(target_os = "linux") {
+        eprintln!("skipping: needs gcc and GNU ld");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let code = r#"#include <stdlib.h>
+static int *make(void) { return malloc(sizeof(int)); }
+#ifndef TEST
+int main(void) { free(make()); return 0; }
+#else
+#include "clings_test.h"
+TEST(test_freed) { free(make()); ASSERT_NO_LEAKS(); ASSERT_ALLOCS_LE(1); }
+TEST(test_leaked) { int *p = make(); ASSERT(p != NULL); ASSERT_NO_LEAKS(); }
+TEST(test_too_many) {
+    static int *p[70000];
+    for (int i = 0; i < 70000; i++) p[i] = make();
+    for (int i = 0; i < 70000; i++) free(p[i]);
+    ASSERT_NO_LEAKS();
+}
+int main(void) {
+    RUN_TEST(test_freed); RUN_TEST(test_leaked); RUN_TEST(test_too_many); TEST_REPORT();
+}
+#endif
+"#;
+    setup_project(tmp.path(), &[("leaky", "02_memory", code)]);
+    let toml = std::fs::read_to_string(tmp.path().join("info.toml")).unwrap();
+    std::fs::write(tmp.path().join("info.toml"), toml.replace("test = false", "test = true")).unwrap();
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let record: serde_json::Value = serde_json::from_str(stdout.trim()).unwrap();
+    assert_eq!(record["stage"], "tests", "got: {stdout}");
+    let text = record["output"].as_str().unwrap();
+    assert!(text.contains("test_freed") && text.contains("ok"), "got: {text}");
+    assert!(text.contains("leaked 1 block(s), 4 bytes"), "got: {text}");
+    let leaked = &record["tests"][1];
+    assert_eq!(leaked["status"], "failed", "got: {stdout}");
+    assert!(leaked["file"].as_str().unwrap().ends_with("leaky.c"), "got: {leaked}");
+    assert_eq!(leaked["line"], 8, "got: {leaked}");
+    // More blocks than the tracker holds: no false leak, but a skip.
+    assert_eq!(record["tests"][2]["status"], "passed", "got: {stdout}");
+    assert!(text.contains("leak check skipped"), "got: {text}");
+}
+
+#[test]
+fn cli_verify_keeps_test_results_past_the_output_limit() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let code = r#"#ifndef TEST
+int main(void) { return 0; }
+#else
+#include "clings_test.h"
+TEST(test_noisy) { for (int i = 0; i < 1000; i++) printf("noise %d\n", i); ASSERT(1); }
+TEST(test_quiet) { ASSERT_EQ(1, 2); }
+int main(void) { RUN_TEST(test_noisy); RUN_TEST(test_quiet); TEST_REPORT(); }
+#endif
+"#;
+    setup_project(tmp.path(), &[("noisy", "02_memory", code)]);
+    std::fs::write(
+        tmp.path().join("info.toml"),
+        "format_version = 1\n\n[[exercises]]\nname = \"noisy\"\ndir = \"02_memory\"\n\
+         output_limit = 256\n",
+    )
+    .unwrap();
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let record: serde_json::Value = serde_json::from_str(stdout.trim()).unwrap();
+    assert_eq!(record["stage"], "tests", "got: {stdout}");
+    assert!(record["output"].as_str().unwrap().contains("bytes of output omitted"), "got: {stdout}");
+    let statuses: Vec<_> = record["tests"]
+        .as_array()
+        .expect("per-test results")
+        .iter()
+        .map(|t| t["status"].as_str().unwrap())
+        .collect();
+    assert_eq!(statuses, ["passed", "failed"], "got: {stdout}");
+}
+
+#[test]
+fn cli_grade_reports_each_workspace() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    setup_project(
+        tmp.path(),
+        &[
+            ("one", "00_intro", "int main(void) { return 0; }\n"),
+            ("two", "00_intro", "int main(void) { return 0; }\n"),
+        ],
+    );
+    let students = tmp.path().join("students");
+    for (student, two) in [("alice", "int main(void) { return 0; }\n"), ("bob", "oops;\n")] {
+        let dir = students.join(student).join("exercises/00_intro");
+        std::fs::create_dir_all(&dir).unwrap();
+        std::fs::write(dir.join("one.c"), "int main(void) { return 0; }\n").unwrap();
+        std::fs::write(dir.join("two.c"), two).unwrap();
+    }
+
+    let output = Command::new(clings_bin())
+        .args(["grade", "--format", "jsonl", "students/alice", "students/bob", "students/nobody"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+
+    assert!(!output.status.success(), "exit code should reflect the failures");
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let records: Vec<serde_json::Value> = stdout
+        .lines()
+        .map(|line| serde_json::from_str(line).expect("every line is a JSON record"))
+        .collect();
+    assert_eq!(records.len(), 3, "got: {stdout}");
+
+    let record = |name: &str| {
+        records
+            .iter()
+            .find(|r| r["workspace"] == format!("students/{name}"))
+            .unwrap()
+    };
+    assert_eq!(record("alice")["passed"], 2);
+    assert_eq!(record("bob")["passed"], 1);
+    assert_eq!(record("bob")["exercises"][1]["stage"], "compilation");
+    assert!(record("nobody")["error"].is_string());
+    assert!(!tmp.path().join("target/clings").read_dir().unwrap().any(|e| e
+        .unwrap()
+        .file_name()
+        .to_string_lossy()
+        .starts_with("grade-")));
+
+    // alice's and bob's identical one.c share a build.
+    let cached = std::fs::read_dir(tmp.path().join("target/clings/cache"))
+        .unwrap()
+        .filter(|e| !e.as_ref().unwrap().file_name().to_string_lossy().starts_with('.'))
+        .count();
+    assert_eq!(cached, 3);
+}
+
+#[test]
+fn cli_verify_reports_timeout_stage() {
+    if !has_gcc() {
+        eprintln!("skipping: gcc not available");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    setup_project(
+        tmp.path(),
+        &[("spin", "00_intro", "int main(void) { for (;;) {} }\n")],
+    );
+    let info = std::fs::read_to_string(tmp.path().join("info.toml")).unwrap();
+    std::fs::write(
+        tmp.path().join("info.toml"),
+        info.replace("format_version = 1\n", "format_version = 1\n[limits]\ntimeout_secs = 0.5\n"),
+    )
+    .unwrap();
+
+    let started = std::time::Instant::now();
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+
+    assert!(!output.status.success());
+    assert!(started.elapsed() < std::time::Duration::from_secs(10));
+    let record: serde_json::Value =
+        serde_json::from_str(String::from_utf8_lossy(&output.stdout).trim()).unwrap();
+    assert_eq!(record["stage"], "timeout");
+    assert!(record["output"].as_str().unwrap().contains("timeout_secs"));
+}
+
 #[test]
 fn cli_reset_clears_state() {
     if !has_gcc() {
@@ -313,3 +827,125 @@ hints = ["Try using printf", "Check the return value"]
         "hint should show hint text, got: {stdout}"
     );
 }
+
+#[test]
+fn cli_verify_isolated_tests_report_crashes_per_test() {
+    if !has_gcc() || !cfg!(unix) {
+        eprintln!("skipping: needs gcc and fork");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let code = r#"#ifndef TEST
+int main(void) { return 0; }
+#else
+#include "clings_test.h"
+static int *volatile null;
+TEST(test_before) { ASSERT(1); }
+TEST(test_crash) { *null = 1; }
+TEST(test_hang) { for (;;) {} }
+TEST(test_exit) { exit(0); ASSERT(0); }
+TEST(test_after) { ASSERT_EQ(2, 1 + 1); }
+int main(void) {
+    RUN_TEST(test_before);
+    RUN_TEST(test_crash);
+    RUN_TEST(test_hang);
+    RUN_TEST(test_exit);
+    RUN_TEST(test_after);
+    TEST_REPORT();
+}
+#endif
+"#;
+    setup_project(tmp.path(), &[("crashy", "07_crash", code)]);
+    std::fs::write(
+        tmp.path().join("info.toml"),
+        "format_version = 1\n\n[[exercises]]\nname = \"crashy\"\ndir = \"07_crash\"\n\
+         isolate_tests = true\n",
+    )
+    .unwrap();
+
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .env("CLINGS_TEST_TIMEOUT", "1")
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let record: serde_json::Value =
+        serde_json::from_str(stdout.lines().next().expect("one record")).unwrap();
+    assert_eq!(record["stage"], "tests", "got: {record}");
+    let output = record["output"].as_str().unwrap();
+    assert!(output.contains("CRASHED\n    killed by signal"), "got: {output}");
+    assert!(output.contains("TIMED OUT"), "got: {output}");
+    assert!(output.contains("EXITED (status 0)"), "got: {output}");
+    assert!(output.contains("5 tests, 2 passed, 3 failed"), "got: {output}");
+    let order: Vec<_> = ["test_before", "test_crash", "test_hang", "test_exit", "test_after"]
+        .iter()
+        .map(|name| output.find(name).unwrap())
+        .collect();
+    assert!(order.windows(2).all(|w| w[0] < w[1]), "got: {output}");
+    assert!(!output.contains("#clings"), "report lines should be hidden: {output}");
+
+    let statuses: Vec<_> = record["tests"]
+        .as_array()
+        .expect("per-test results")
+        .iter()
+        .map(|t| (t["test"].as_str().unwrap(), t["status"].as_str().unwrap()))
+        .collect();
+    assert_eq!(
+        statuses,
+        [
+            ("test_before", "passed"),
+            ("test_crash", "crashed"),
+            ("test_hang", "timed_out"),
+            ("test_exit", "exited"),
+            ("test_after", "passed"),
+        ]
+    );
+}
+
+#[test]
+fn cli_verify_isolated_tests_time_out_before_the_stage() {
+    if !has_gcc() || !cfg!(unix) {
+        eprintln!("skipping: needs gcc and fork");
+        return;
+    }
+
+    let tmp = TempDir::new().unwrap();
+    let code = r#"#ifndef TEST
+int main(void) { return 0; }
+#else
+#include "clings_test.h"
+TEST(test_hang) { for (;;) {} }
+TEST(test_after) { ASSERT(1); }
+int main(void) {
+    RUN_TEST(test_hang);
+    RUN_TEST(test_after);
+    TEST_REPORT();
+}
+#endif
+"#;
+    setup_project(tmp.path(), &[("hangs", "07_hang", code)]);
+    std::fs::write(
+        tmp.path().join("info.toml"),
+        "format_version = 1\n\n[[exercises]]\nname = \"hangs\"\ndir = \"07_hang\"\n\
+         isolate_tests = true\nlimits = { timeout_secs = 2.0 }\n",
+    )
+    .unwrap();
+
+    // No CLINGS_TEST_TIMEOUT of our own: the hanging test must still time
+    // out before the 2 s stage does, so test_after gets to report.
+    let output = Command::new(clings_bin())
+        .args(["verify", "--format", "jsonl"])
+        .env_remove("CLINGS_TEST_TIMEOUT")
+        .current_dir(tmp.path())
+        .output()
+        .unwrap();
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let record: serde_json::Value =
+        serde_json::from_str(stdout.lines().next().expect("one record")).unwrap();
+    assert_eq!(record["stage"], "tests", "got: {record}");
+    let output = record["output"].as_str().unwrap();
+    assert!(output.contains("TIMED OUT\n    after 1 s"), "got: {output}");
+    assert!(output.contains("2 tests, 1 passed, 1 failed"), "got: {output}");
+}